@@ -27,8 +27,10 @@
 
 /* ANSI C header files. */
 
+#include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 
 /* Acorn C header files */
 
@@ -58,6 +60,7 @@
 
 #include "filing.h"
 #include "paneldb.h"
+#include "reach.h"
 
 /**
  * The number of new blocks to allocate when more space is required.
@@ -71,6 +74,12 @@
 
 #define APPDB_FILER_BOOT_LENGTH 25
 
+/**
+ * The length of the buffer used to read lines from the usage file.
+ */
+
+#define APPDB_USAGE_LINE_LENGTH (APPDB_COMMAND_LENGTH + 32)
+
 /**
  * The internal database entry container.
  */
@@ -87,6 +96,18 @@ struct appdb_container {
 	 */
 
 	struct appdb_entry	entry;	
+
+	/**
+	 * The number of times that the entry has been launched.
+	 */
+
+	unsigned		launches;
+
+	/**
+	 * The time at which the entry was last launched, or 0.
+	 */
+
+	time_t			last_used;
 };
 
 /**
@@ -137,6 +158,12 @@ static unsigned				appdb_key = 0;
 
 static osbool				appdb_unsafe = FALSE;
 
+/**
+ * Track whether the usage statistics have changed since the last save.
+ */
+
+static osbool				appdb_usage_changed = FALSE;
+
 /* Static Function Prototypes. */
 
 static char *appdb_boot_action_to_token(enum appdb_boot_action action);
@@ -144,6 +171,7 @@ static enum appdb_boot_action appdb_boot_token_to_action(char *token);
 static int appdb_find(unsigned key);
 static int appdb_new();
 static void appdb_delete(int index);
+static int appdb_compare_usage(const void *a, const void *b);
 
 /**
  * Initialise the application database.
@@ -177,6 +205,7 @@ void appdb_reset(void)
 	appdb_apps = 0;
 	appdb_key = 0;
 	appdb_unsafe = FALSE;
+	appdb_usage_changed = FALSE;
 }
 
 
@@ -405,11 +434,38 @@ osbool appdb_data_unsafe(void)
 
 void appdb_boot_all(void)
 {
-	int		current;
+	int		i, current, *order;
 	char		command[APPDB_FILER_BOOT_LENGTH + APPDB_COMMAND_LENGTH];
 	os_error	*error;
 
-	for (current = 0; current < appdb_apps; current++) {
+	/* Boot the most used applications first, so that they are ready as
+	 * soon as possible. If there's no memory to sort the list, just
+	 * boot them in database order.
+	 */
+
+	order = (appdb_apps > 0) ? heap_alloc(appdb_apps * sizeof(int)) : NULL;
+
+	if (order != NULL) {
+		for (i = 0; i < appdb_apps; i++)
+			order[i] = i;
+
+		qsort(order, appdb_apps, sizeof(int), appdb_compare_usage);
+	}
+
+	for (i = 0; i < appdb_apps; i++) {
+		current = (order != NULL) ? order[i] : i;
+
+		if (appdb_list[current].entry.boot_action != APPDB_BOOT_ACTION_BOOT &&
+				appdb_list[current].entry.boot_action != APPDB_BOOT_ACTION_SPRITES)
+			continue;
+
+		/* Skip anything on a disc which isn't responding; the probe
+		 * will only wait for each disc once.
+		 */
+
+		if (reach_probe(appdb_list[current].entry.command) == REACH_STATE_UNREACHABLE)
+			continue;
+
 		switch (appdb_list[current].entry.boot_action) {
 		case APPDB_BOOT_ACTION_BOOT:
 			string_printf(command, APPDB_FILER_BOOT_LENGTH + APPDB_COMMAND_LENGTH, "Filer_Boot %s", appdb_list[current].entry.command);
@@ -427,6 +483,156 @@ void appdb_boot_all(void)
 				(error_msgs_param_report_error("BootFail", appdb_list[current].entry.name, error->errmess, NULL, NULL) == wimp_ERROR_BOX_SELECTED_CANCEL))
 			break;
 	}
+
+	if (order != NULL)
+		heap_free(order);
+}
+
+
+/**
+ * Compare two database entries by usage, so that the most used sort first.
+ * Entries with equal launch counts sort by the time that they were last
+ * used, and then into database order.
+ *
+ * \param *a		Pointer to the index of the first entry.
+ * \param *b		Pointer to the index of the second entry.
+ * \return		The result of the comparison.
+ */
+
+static int appdb_compare_usage(const void *a, const void *b)
+{
+	struct appdb_container	*first = appdb_list + *((int *) a);
+	struct appdb_container	*second = appdb_list + *((int *) b);
+
+	if (first->launches != second->launches)
+		return (first->launches > second->launches) ? -1 : 1;
+
+	if (first->last_used != second->last_used)
+		return (first->last_used > second->last_used) ? -1 : 1;
+
+	return *((int *) a) - *((int *) b);
+}
+
+
+/**
+ * Record that an entry has been launched, updating its usage statistics.
+ *
+ * \param key		The key of the entry which was launched.
+ */
+
+void appdb_record_launch(unsigned key)
+{
+	int index;
+
+	index = appdb_find(key);
+
+	if (index == -1)
+		return;
+
+	appdb_list[index].launches++;
+	appdb_list[index].last_used = time(NULL);
+
+	appdb_usage_changed = TRUE;
+}
+
+
+/**
+ * Return the number of times that an entry has been launched.
+ *
+ * \param key		The key of the entry to query.
+ * \return		The number of launches.
+ */
+
+unsigned appdb_get_launch_count(unsigned key)
+{
+	int index;
+
+	index = appdb_find(key);
+
+	return (index != -1) ? appdb_list[index].launches : 0;
+}
+
+
+/**
+ * Indicate whether the usage statistics have changed since they were last
+ * saved.
+ *
+ * \return		TRUE if there are unsaved statistics; else FALSE.
+ */
+
+osbool appdb_usage_unsafe(void)
+{
+	return appdb_usage_changed;
+}
+
+
+/**
+ * Load usage statistics from a usage file, matching them to entries by
+ * their RunPath. Lines which don't match any entry are ignored.
+ *
+ * \param *file		The file handle to load from.
+ * \return		TRUE on success; else FALSE.
+ */
+
+osbool appdb_load_usage_file(FILE *file)
+{
+	char		line[APPDB_USAGE_LINE_LENGTH], *command;
+	unsigned	launches;
+	unsigned long	last_used;
+	int		current, offset;
+
+	if (file == NULL)
+		return FALSE;
+
+	while (fgets(line, APPDB_USAGE_LINE_LENGTH, file) != NULL) {
+		if (*line == '#' || sscanf(line, "%u %lu %n", &launches, &last_used, &offset) != 2)
+			continue;
+
+		command = line + offset;
+		command[strcspn(command, "\r\n")] = '\0';
+
+		for (current = 0; current < appdb_apps; current++) {
+			if (strcmp(appdb_list[current].entry.command, command) != 0)
+				continue;
+
+			appdb_list[current].launches = launches;
+			appdb_list[current].last_used = (time_t) last_used;
+		}
+	}
+
+	appdb_usage_changed = FALSE;
+
+	return TRUE;
+}
+
+
+/**
+ * Save the usage statistics of the buttons database into a usage file,
+ * with one line per entry holding its launch count, the time it was
+ * last used, and its RunPath.
+ *
+ * \param *file		The file handle to save to.
+ * \return		TRUE on success; else FALSE.
+ */
+
+osbool appdb_save_usage_file(FILE *file)
+{
+	int current;
+
+	if (file == NULL)
+		return FALSE;
+
+	for (current = 0; current < appdb_apps; current++) {
+		if (appdb_list[current].launches == 0)
+			continue;
+
+		fprintf(file, "%u %lu %s\n", appdb_list[current].launches,
+				(unsigned long) appdb_list[current].last_used, appdb_list[current].entry.command);
+	}
+
+	appdb_usage_changed = FALSE;
+
+	return TRUE;
 }
 
 
@@ -618,6 +824,8 @@ static int appdb_new()
 		return -1;
 
 	appdb_list[appdb_apps].key = appdb_key++;
+	appdb_list[appdb_apps].launches = 0;
+	appdb_list[appdb_apps].last_used = 0;
 	appdb_set_defaults(&(appdb_list[appdb_apps].entry));
 
 	appdb_unsafe = TRUE;
@@ -178,6 +178,58 @@ osbool appdb_data_unsafe(void);
 void appdb_boot_all(void);
 
 
+/**
+ * Record that an entry has been launched, updating its usage statistics.
+ *
+ * \param key		The key of the entry which was launched.
+ */
+
+void appdb_record_launch(unsigned key);
+
+
+/**
+ * Return the number of times that an entry has been launched.
+ *
+ * \param key		The key of the entry to query.
+ * \return		The number of launches.
+ */
+
+unsigned appdb_get_launch_count(unsigned key);
+
+
+/**
+ * Indicate whether the usage statistics have changed since they were last
+ * saved.
+ *
+ * \return		TRUE if there are unsaved statistics; else FALSE.
+ */
+
+osbool appdb_usage_unsafe(void);
+
+
+/**
+ * Load usage statistics from a usage file, matching them to entries by
+ * their RunPath. Lines which don't match any entry are ignored.
+ *
+ * \param *file		The file handle to load from.
+ * \return		TRUE on success; else FALSE.
+ */
+
+osbool appdb_load_usage_file(FILE *file);
+
+
+/**
+ * Save the usage statistics of the buttons database into a usage file,
+ * with one line per entry holding its launch count, the time it was
+ * last used, and its RunPath.
+ *
+ * \param *file		The file handle to save to.
+ * \return		TRUE on success; else FALSE.
+ */
+
+osbool appdb_save_usage_file(FILE *file);
+
+
 /**
  * Create a new, empty entry in the database and return its key.
  *
@@ -0,0 +1,282 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: backing.c
+ */
+
+/* ANSI C header files. */
+
+#include <stddef.h>
+
+/* OSLib header files. */
+
+#include "oslib/os.h"
+#include "oslib/osscreenmode.h"
+#include "oslib/osspriteop.h"
+#include "oslib/wimp.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/errors.h"
+#include "sflib/heap.h"
+
+/* Application header files. */
+
+#include "backing.h"
+
+/**
+ * The name given to backing store sprites.
+ */
+
+#define BACKING_SPRITE_NAME "backing"
+
+/**
+ * The Wimp_SetColour flag to set the background colour.
+ */
+
+#define BACKING_WIMP_BACKGROUND 0x80
+
+/**
+ * A backing store instance.
+ */
+
+struct backing_block {
+	/**
+	 * The sprite area holding the backing sprite.
+	 */
+
+	osspriteop_area *area;
+
+	/**
+	 * Pointer to the backing sprite within the area.
+	 */
+
+	osspriteop_header *sprite;
+
+	/**
+	 * The area of the work area covered by the sprite, in OS units.
+	 */
+
+	os_box extent;
+
+	/**
+	 * The VDU context saved while output is switched to the sprite.
+	 */
+
+	int context[4];
+};
+
+
+/**
+ * Create a new backing store sprite, in the current screen mode, to cover
+ * a given area of a window's work area.
+ *
+ * \param *extent	The area of the work area to be covered, in OS units;
+ *			this will be rounded out to whole pixels.
+ * \param limit		The maximum size of the sprite area, in bytes.
+ * \return		The new backing store instance, or NULL if the sprite
+ *			would exceed the limit or could not be created.
+ */
+
+struct backing_block *backing_create(os_box *extent, int limit)
+{
+	struct backing_block	*new;
+	os_mode			mode;
+	os_error		*error;
+	int			xeig, yeig, log2bpp, width, height, row_bytes, size;
+
+	if (extent == NULL || extent->x1 <= extent->x0 || extent->y1 <= extent->y0)
+		return NULL;
+
+	/* Calculate the size of sprite that would be needed. */
+
+	error = xosscreenmode_current(&mode);
+	if (error != NULL)
+		return NULL;
+
+	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_XEIG_FACTOR, &xeig);
+	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_YEIG_FACTOR, &yeig);
+	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_LOG2_BPP, &log2bpp);
+
+	width = ((extent->x1 - extent->x0) >> xeig) + 2;
+	height = ((extent->y1 - extent->y0) >> yeig) + 2;
+
+	row_bytes = (((width << log2bpp) + 31) >> 5) << 2;
+	size = sizeof(osspriteop_area) + sizeof(osspriteop_header) + (row_bytes * height);
+
+	if (size > limit)
+		return NULL;
+
+	/* Allocate the memory. */
+
+	new = heap_alloc(sizeof(struct backing_block));
+	if (new == NULL)
+		return NULL;
+
+	new->area = heap_alloc(size);
+	if (new->area == NULL) {
+		heap_free(new);
+		return NULL;
+	}
+
+	/* Round the extent out to whole pixels, using the extra pixel which
+	 * was allowed at each side.
+	 */
+
+	new->extent.x0 = (extent->x0 >> xeig) << xeig;
+	new->extent.y0 = (extent->y0 >> yeig) << yeig;
+	new->extent.x1 = new->extent.x0 + (width << xeig);
+	new->extent.y1 = new->extent.y0 + (height << yeig);
+
+	/* Create the sprite. */
+
+	new->area->size = size;
+	new->area->sprite_count = 0;
+	new->area->first = sizeof(osspriteop_area);
+	new->area->used = sizeof(osspriteop_area);
+
+	error = xosspriteop_create_sprite(osspriteop_USER_AREA, new->area, BACKING_SPRITE_NAME, FALSE, width, height, mode);
+	if (error == NULL)
+		error = xosspriteop_select_sprite(osspriteop_USER_AREA, new->area, (osspriteop_id) BACKING_SPRITE_NAME, &(new->sprite));
+
+	if (error != NULL) {
+		backing_destroy(new);
+		return NULL;
+	}
+
+	return new;
+}
+
+
+/**
+ * Destroy a backing store instance, freeing its memory.
+ *
+ * \param *instance	The backing store instance to destroy.
+ */
+
+void backing_destroy(struct backing_block *instance)
+{
+	if (instance == NULL)
+		return;
+
+	if (instance->area != NULL)
+		heap_free(instance->area);
+
+	heap_free(instance);
+}
+
+
+/**
+ * Return the area of the work area covered by a backing store instance,
+ * after it has been rounded out to whole pixels.
+ *
+ * \param *instance	The backing store instance to query.
+ * \param *extent	Pointer to a box to take the covered area.
+ */
+
+void backing_get_extent(struct backing_block *instance, os_box *extent)
+{
+	if (instance == NULL || extent == NULL)
+		return;
+
+	*extent = instance->extent;
+}
+
+
+/**
+ * Switch VDU output into a backing store sprite, and clear it to a given
+ * Wimp colour. Icons plotted until output is restored must be positioned
+ * relative to the bottom-left corner of the covered area.
+ *
+ * \param *instance	The backing store instance to switch output to.
+ * \param background	The Wimp colour to clear the sprite to.
+ * \return		TRUE if output was switched; else FALSE.
+ */
+
+osbool backing_start_output(struct backing_block *instance, wimp_colour background)
+{
+	os_error *error;
+
+	if (instance == NULL)
+		return FALSE;
+
+	error = xosspriteop_switch_output_to_sprite(osspriteop_PTR, instance->area, (osspriteop_id) instance->sprite, NULL,
+			&(instance->context[0]), &(instance->context[1]), &(instance->context[2]), &(instance->context[3]));
+	if (error != NULL) {
+		error_report_program(error);
+		return FALSE;
+	}
+
+	error = xwimp_set_colour(background | BACKING_WIMP_BACKGROUND);
+	if (error == NULL)
+		error = xos_writec(os_VDU_CLG);
+
+	if (error != NULL) {
+		backing_end_output(instance);
+		error_report_program(error);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Restore VDU output after a call to backing_start_output().
+ *
+ * \param *instance	The backing store instance to switch output from.
+ */
+
+void backing_end_output(struct backing_block *instance)
+{
+	os_error *error;
+
+	if (instance == NULL)
+		return;
+
+	error = xosspriteop_unswitch_output(instance->context[0], instance->context[1], instance->context[2], instance->context[3]);
+	if (error != NULL)
+		error_report_program(error);
+}
+
+
+/**
+ * Plot a backing store sprite during a window redraw, so that it lines up
+ * with the area of the work area which it covers. The Wimp's graphics
+ * window will clip the plot to the current redraw rectangle.
+ *
+ * \param *instance	The backing store instance to plot.
+ * \param *origin	The screen coordinates of the work area origin.
+ * \return		TRUE if the sprite was plotted; else FALSE.
+ */
+
+osbool backing_plot(struct backing_block *instance, os_coord *origin)
+{
+	if (instance == NULL || origin == NULL)
+		return FALSE;
+
+	return (xosspriteop_put_sprite_user_coords(osspriteop_PTR, instance->area, (osspriteop_id) instance->sprite,
+			origin->x + instance->extent.x0, origin->y + instance->extent.y0, os_ACTION_OVERWRITE) == NULL) ? TRUE : FALSE;
+}
+
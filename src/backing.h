@@ -0,0 +1,110 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: backing.h
+ *
+ * Off-screen backing store sprites, into which window contents can be
+ * rendered once and then plotted in a single operation on redraw.
+ */
+
+#ifndef LAUNCHER_BACKING
+#define LAUNCHER_BACKING
+
+/**
+ * A backing store instance.
+ */
+
+struct backing_block;
+
+
+/**
+ * Create a new backing store sprite, in the current screen mode, to cover
+ * a given area of a window's work area.
+ *
+ * \param *extent	The area of the work area to be covered, in OS units;
+ *			this will be rounded out to whole pixels.
+ * \param limit		The maximum size of the sprite area, in bytes.
+ * \return		The new backing store instance, or NULL if the sprite
+ *			would exceed the limit or could not be created.
+ */
+
+struct backing_block *backing_create(os_box *extent, int limit);
+
+
+/**
+ * Destroy a backing store instance, freeing its memory.
+ *
+ * \param *instance	The backing store instance to destroy.
+ */
+
+void backing_destroy(struct backing_block *instance);
+
+
+/**
+ * Return the area of the work area covered by a backing store instance,
+ * after it has been rounded out to whole pixels.
+ *
+ * \param *instance	The backing store instance to query.
+ * \param *extent	Pointer to a box to take the covered area.
+ */
+
+void backing_get_extent(struct backing_block *instance, os_box *extent);
+
+
+/**
+ * Switch VDU output into a backing store sprite, and clear it to a given
+ * Wimp colour. Icons plotted until output is restored must be positioned
+ * relative to the bottom-left corner of the covered area.
+ *
+ * \param *instance	The backing store instance to switch output to.
+ * \param background	The Wimp colour to clear the sprite to.
+ * \return		TRUE if output was switched; else FALSE.
+ */
+
+osbool backing_start_output(struct backing_block *instance, wimp_colour background);
+
+
+/**
+ * Restore VDU output after a call to backing_start_output().
+ *
+ * \param *instance	The backing store instance to switch output from.
+ */
+
+void backing_end_output(struct backing_block *instance);
+
+
+/**
+ * Plot a backing store sprite during a window redraw, so that it lines up
+ * with the area of the work area which it covers. The Wimp's graphics
+ * window will clip the plot to the current redraw rectangle.
+ *
+ * \param *instance	The backing store instance to plot.
+ * \param *origin	The screen coordinates of the work area origin.
+ * \return		TRUE if the sprite was plotted; else FALSE.
+ */
+
+osbool backing_plot(struct backing_block *instance, os_coord *origin);
+
+#endif
+
@@ -79,6 +79,12 @@
 
 #define FILING_NEW_DATA_FORMAT 200
 
+/**
+ * The leafname of the usage statistics file saved alongside the buttons.
+ */
+
+#define FILING_USAGE_LEAF "Usage"
+
 /**
  * The file load and save handle structure.
  */
@@ -100,6 +106,10 @@ struct filing_block {
 
 #define filing_load_status_is_ok(status) (((status) == FILING_STATUS_OK) || ((status) == FILING_STATUS_UNEXPECTED))
 
+/* Static Function Prototypes. */
+
+static void filing_load_usage(void);
+
 
 /**
  * Load the contents of a button file into the respective databases.
@@ -210,6 +220,10 @@ osbool filing_load(char *leaf_name)
 		return FALSE;
 	}
 
+	/* Pick up the usage statistics for the buttons, if there are any. */
+
+	filing_load_usage();
+
 	hourglass_off();
 
 	if (in.status == FILING_STATUS_UNEXPECTED)
@@ -220,10 +234,11 @@ osbool filing_load(char *leaf_name)
 
 
 /**
- * Save the contents of the respective databases into a buttons file.
+ * Save the contents of the respective databases into a buttons file, and
+ * the button usage statistics into the usage file which accompanies it.
  *
  * \param *leaf_name	The file leafname to save to.
- * \return		TRUE on success; else FALSE.
+ * \return		TRUE if the buttons file was saved; else FALSE.
  */
 
 osbool filing_save(char *leaf_name)
@@ -255,10 +270,74 @@ osbool filing_save(char *leaf_name)
 
 	fclose(file);
 
+	/* The usage statistics go in a file of their own, so failing to save
+	 * them doesn't mean that the buttons weren't saved.
+	 */
+
+	filing_save_usage();
+
 	return TRUE;
+}
 
+
+/**
+ * Save the button usage statistics into the usage file which accompanies
+ * the buttons file.
+ *
+ * \return		TRUE on success; else FALSE.
+ */
+
+osbool filing_save_usage(void)
+{
+	char	filename[FILING_MAX_FILENAME_LENGTH];
+	FILE	*file;
+
+	config_find_save_file(filename, FILING_MAX_FILENAME_LENGTH, FILING_USAGE_LEAF);
+
+	if (*filename == '\0')
+		return FALSE;
+
+	file = fopen(filename, "w");
+
+	if (file == NULL)
+		return FALSE;
+
+	fprintf(file, "# >Usage\n#\n# Saved by Launcher.\n");
+
+	appdb_save_usage_file(file);
+
+	fclose(file);
+
+	return TRUE;
+}
+
+
+/**
+ * Load the button usage statistics from the usage file which accompanies
+ * the buttons file, if one exists.
+ */
+
+static void filing_load_usage(void)
+{
+	char	filename[FILING_MAX_FILENAME_LENGTH];
+	FILE	*file;
+
+	config_find_load_file(filename, FILING_MAX_FILENAME_LENGTH, FILING_USAGE_LEAF);
+
+	if (*filename == '\0')
+		return;
+
+	file = fopen(filename, "r");
+
+	if (file == NULL)
+		return;
+
+	appdb_load_usage_file(file);
+
+	fclose(file);
 }
 
+
 /**
  * Return details of the next section contained in the file.
  *
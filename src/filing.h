@@ -59,15 +59,26 @@ osbool filing_load(char *leaf_name);
 
 
 /**
- * Save the contents of the respective databases into a buttons file.
+ * Save the contents of the respective databases into a buttons file, and
+ * the button usage statistics into the usage file which accompanies it.
  *
  * \param *leaf_name	The file leafname to save to.
- * \return		TRUE on success; else FALSE.
+ * \return		TRUE if the buttons file was saved; else FALSE.
  */
 
 osbool filing_save(char *leaf_name);
 
 
+/**
+ * Save the button usage statistics into the usage file which accompanies
+ * the buttons file.
+ *
+ * \return		TRUE on success; else FALSE.
+ */
+
+osbool filing_save_usage(void);
+
+
 /**
  * Return details of the next section contained in the file.
  *
@@ -40,6 +40,7 @@
 #include "icondb.h"
 
 #include "appdb.h"
+#include "objutil.h"
 
 /**
  * Structure to hold an icondb instance.
@@ -61,6 +62,11 @@ struct icondb_block {
 
 static struct icondb_block *icondb_instances = NULL;
 
+/* Static Function Prototypes. */
+
+static void icondb_link_icon(struct icondb_block *instance, struct icondb_button *button);
+static void icondb_unlink_icon(struct icondb_block *instance, struct icondb_button *button);
+
 
 
 /**
@@ -170,7 +176,7 @@ void icondb_reset_instance(struct icondb_block *instance)
 
 struct icondb_button *icondb_create_icon(struct icondb_block *instance, unsigned key, os_coord *position)
 {
-	struct icondb_button *button = NULL, **current = NULL;
+	struct icondb_button *button = NULL;
 
 	if (instance == NULL || key == APPDB_NULL_KEY)
 		return NULL;
@@ -186,25 +192,58 @@ struct icondb_button *icondb_create_icon(struct icondb_block *instance, unsigned
 	button->window = NULL;
 	button->icon = -1;
 	button->text = NULL;
+	button->text_name = NULL;
+	button->text_width = 0;
+	button->text_generation = 0;
+	button->ideal.x = position->x;
+	button->ideal.y = position->y;
 	button->position.x = position->x;
 	button->position.y = position->y;
+	button->extent.x0 = 0;
+	button->extent.y0 = 0;
+	button->extent.x1 = 0;
+	button->extent.y1 = 0;
 	button->inset.x0 = 0;
 	button->inset.y0 = 0;
 	button->inset.x1 = 0;
 	button->inset.y1 = 0;
+	button->stale = FALSE;
+
+	objutil_clear_target(&(button->target));
+	button->pressed = FALSE;
+	button->unreachable = FALSE;
+	button->running = FALSE;
 
 	/* Link the icon into the database, in descending position order. */
 
-	current = &(instance->buttons);
+	icondb_link_icon(instance, button);
 
-	while ((*current != NULL) && (((*current)->position.y < position->y) ||
-			(((*current)->position.y == position->y) && ((*current)->position.x < position->x))))
-		current = &((*current)->next);
+	return button;
+}
 
-	button->next = *current;
-	*current = button;
 
-	return button;
+/**
+ * Move an existing button entry in an icon database instance to a
+ * new position, relinking it into the list as required.
+ *
+ * \param *instance	The instance holding the button.
+ * \param *button	Pointer to the entry to move.
+ * \param *position	The new position to assign to the entry.
+ */
+
+void icondb_move_icon(struct icondb_block *instance, struct icondb_button *button, os_coord *position)
+{
+	if (instance == NULL || button == NULL || position == NULL)
+		return;
+
+	icondb_unlink_icon(instance, button);
+
+	button->ideal.x = position->x;
+	button->ideal.y = position->y;
+	button->position.x = position->x;
+	button->position.y = position->y;
+
+	icondb_link_icon(instance, button);
 }
 
 
@@ -217,26 +256,17 @@ struct icondb_button *icondb_create_icon(struct icondb_block *instance, unsigned
 
 void icondb_delete_icon(struct icondb_block *instance, struct icondb_button *button)
 {
-	struct icondb_button *parent = NULL;
-
 	if (instance == NULL)
 		return;
 
-	if (instance->buttons == button) {
-		instance->buttons = button->next;
-	} else {
-		parent = instance->buttons;
-
-		while (parent != NULL && parent->next != button)
-			parent = parent->next;
-
-		if (parent != NULL)
-			parent->next = button->next;
-	}
+	icondb_unlink_icon(instance, button);
 
 	if (button->text != NULL)
 		heap_free(button->text);
 
+	if (button->text_name != NULL)
+		heap_free(button->text_name);
+
 	heap_free(button);
 }
 
@@ -282,3 +312,78 @@ struct icondb_button *icondb_find_icon(struct icondb_block *instance, wimp_w win
 	return button;
 }
 
+
+/**
+ * Given an application database key, find the associated entry in an
+ * icon database instance.
+ *
+ * \param *instance	The instance to search within.
+ * \param key		The database key to search for.
+ * \return		The associated IconDB entry, or NULL.
+ */
+
+struct icondb_button *icondb_find_key(struct icondb_block *instance, unsigned key)
+{
+	struct icondb_button *button;
+
+	if (instance == NULL)
+		return NULL;
+
+	button = instance->buttons;
+
+	while (button != NULL && button->key != key)
+		button = button->next;
+
+	return button;
+}
+
+
+/**
+ * Link a button entry into an icon database instance, according to its
+ * position in the panel.
+ *
+ * \param *instance	The instance to link the button into.
+ * \param *button	Pointer to the entry to link in.
+ */
+
+static void icondb_link_icon(struct icondb_block *instance, struct icondb_button *button)
+{
+	struct icondb_button **current = NULL;
+
+	current = &(instance->buttons);
+
+	while ((*current != NULL) && (((*current)->ideal.y < button->ideal.y) ||
+			(((*current)->ideal.y == button->ideal.y) && ((*current)->ideal.x < button->ideal.x))))
+		current = &((*current)->next);
+
+	button->next = *current;
+	*current = button;
+}
+
+
+/**
+ * Unlink a button entry from an icon database instance, without freeing
+ * the memory that it uses.
+ *
+ * \param *instance	The instance to unlink the button from.
+ * \param *button	Pointer to the entry to unlink.
+ */
+
+static void icondb_unlink_icon(struct icondb_block *instance, struct icondb_button *button)
+{
+	struct icondb_button *parent = NULL;
+
+	if (instance->buttons == button) {
+		instance->buttons = button->next;
+	} else {
+		parent = instance->buttons;
+
+		while (parent != NULL && parent->next != button)
+			parent = parent->next;
+
+		if (parent != NULL)
+			parent->next = button->next;
+	}
+
+	button->next = NULL;
+}
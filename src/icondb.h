@@ -28,6 +28,8 @@
 #ifndef LAUNCHER_ICONDB
 #define LAUNCHER_ICONDB
 
+#include "objutil.h"
+
 /**
  * An icon database instance.
  */
@@ -63,18 +65,79 @@ struct icondb_button {
 	 */
 	char		*text;
 
+	/**
+	 * Pointer to storage for the name from which the icon's text was
+	 * truncated, to allow the text to be reused if it is unchanged.
+	 */
+	char		*text_name;
+
+	/**
+	 * The width, in OS units, to which the icon's text was truncated.
+	 */
+	int		text_width;
+
+	/**
+	 * The label generation in which the icon's text was truncated.
+	 */
+	unsigned	text_generation;
+
+	/**
+	 * The requested position of the icon in the panel, before reflowing.
+	 */
+
+	os_coord	ideal;
+
 	/**
 	 * The actual position of the icon in the panel, after reflowing.
 	 */
 
 	os_coord	position;
 
+	/**
+	 * The extent of the icon in the window, if one has been created.
+	 */
+
+	os_box		extent;
+
 	/**
 	 * The position of the inset within the icon.
 	 */
 
 	os_box		inset;
 
+	/**
+	 * TRUE if the button has not yet been matched to an entry during
+	 * a refresh from the application database.
+	 */
+
+	osbool		stale;
+
+	/**
+	 * The cached details of the object launched by the button.
+	 */
+
+	struct objutil_target	target;
+
+	/**
+	 * TRUE if the button is shown pressed while its launch is in progress.
+	 */
+
+	osbool		pressed;
+
+	/**
+	 * TRUE if the button is shown shaded because its target's disc
+	 * isn't responding.
+	 */
+
+	osbool		unreachable;
+
+	/**
+	 * TRUE if the button is marked as having started a task which is
+	 * still running.
+	 */
+
+	osbool		running;
+
 	/**
 	 * Pointer to the next button definition.
 	 */
@@ -136,6 +199,18 @@ void icondb_reset_instance(struct icondb_block *instance);
 struct icondb_button *icondb_create_icon(struct icondb_block *instance, unsigned key, os_coord *position);
 
 
+/**
+ * Move an existing button entry in an icon database instance to a
+ * new position, relinking it into the list as required.
+ *
+ * \param *instance	The instance holding the button.
+ * \param *button	Pointer to the entry to move.
+ * \param *position	The new position to assign to the entry.
+ */
+
+void icondb_move_icon(struct icondb_block *instance, struct icondb_button *button, os_coord *position);
+
+
 /**
  * Delete a button entry from an icon database instance.
  *
@@ -168,5 +243,17 @@ struct icondb_button *icondb_get_list(struct icondb_block *instance);
 
 struct icondb_button *icondb_find_icon(struct icondb_block *instance, wimp_w window, wimp_i icon);
 
+
+/**
+ * Given an application database key, find the associated entry in an
+ * icon database instance.
+ *
+ * \param *instance	The instance to search within.
+ * \param key		The database key to search for.
+ * \return		The associated IconDB entry, or NULL.
+ */
+
+struct icondb_button *icondb_find_key(struct icondb_block *instance, unsigned key);
+
 #endif
 
@@ -0,0 +1,430 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: latency.c
+ */
+
+/* ANSI C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+/* OSLib header files. */
+
+#include "oslib/os.h"
+#include "oslib/osfile.h"
+#include "oslib/wimp.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/errors.h"
+#include "sflib/heap.h"
+
+/* Application header files. */
+
+#include "latency.h"
+
+#include "appdb.h"
+#include "launch.h"
+#include "panel.h"
+
+/**
+ * The number of recent samples held for each interval of each button.
+ */
+
+#define LATENCY_SAMPLES 32
+
+/**
+ * The maximum number of buttons to include in the report.
+ */
+
+#define LATENCY_REPORT_LIMIT 20
+
+/**
+ * The folder in which the report is written. Launcher keeps its own folder
+ * in the scrap directory, so that the report can't clash with another
+ * task's scrap files.
+ */
+
+#define LATENCY_REPORT_DIR "<Wimp$ScrapDir>.Launcher"
+
+/**
+ * The file to which the report is written.
+ */
+
+#define LATENCY_REPORT_FILE LATENCY_REPORT_DIR ".LaunchTimes"
+
+/**
+ * The most recent samples of one interval, held as a rolling window.
+ */
+
+struct latency_series {
+	/**
+	 * The samples, in centiseconds.
+	 */
+
+	int		samples[LATENCY_SAMPLES];
+
+	/**
+	 * The total number of samples recorded; the most recent are held in
+	 * the array, wrapping around when it is full.
+	 */
+
+	unsigned	count;
+};
+
+/**
+ * The latency records for a single button.
+ */
+
+struct latency_button {
+	/**
+	 * The database key of the button.
+	 */
+
+	unsigned		key;
+
+	/**
+	 * The samples for each of the intervals.
+	 */
+
+	struct latency_series	series[LATENCY_INTERVALS];
+
+	/**
+	 * Pointer to the next button in the list.
+	 */
+
+	struct latency_button	*next;
+};
+
+/**
+ * A button's place in the report.
+ */
+
+struct latency_rank {
+	/**
+	 * The button's latency records.
+	 */
+
+	struct latency_button	*button;
+
+	/**
+	 * The value by which the buttons are ranked.
+	 */
+
+	int			time;
+};
+
+/**
+ * The list of buttons with latency records.
+ */
+
+static struct latency_button *latency_list = NULL;
+
+/* Static Function Prototypes. */
+
+static struct latency_button *latency_find_button(unsigned key, osbool create);
+static int latency_get_percentile(struct latency_series *series, int percentile);
+static void latency_write_series(FILE *file, struct latency_series *series);
+static int latency_compare_ranks(const void *a, const void *b);
+static int latency_compare_samples(const void *a, const void *b);
+
+
+/**
+ * Terminate the latency records, freeing their memory.
+ */
+
+void latency_terminate(void)
+{
+	struct latency_button *button;
+
+	while (latency_list != NULL) {
+		button = latency_list;
+		latency_list = button->next;
+
+		heap_free(button);
+	}
+}
+
+
+/**
+ * Record the time taken by one interval of a button's launch.
+ *
+ * \param key		The database key of the button.
+ * \param interval	The interval which was timed.
+ * \param time		The time taken, in centiseconds.
+ */
+
+void latency_record(unsigned key, enum latency_interval interval, int time)
+{
+	struct latency_button	*button;
+	struct latency_series	*series;
+
+	if (interval < 0 || interval >= LATENCY_INTERVALS)
+		return;
+
+	button = latency_find_button(key, TRUE);
+	if (button == NULL)
+		return;
+
+	series = &(button->series[interval]);
+
+	series->samples[series->count % LATENCY_SAMPLES] = (time > 0) ? time : 0;
+	series->count++;
+}
+
+
+/**
+ * Discard the latency records for a button, when it is deleted.
+ *
+ * \param key		The database key of the button.
+ */
+
+void latency_forget(unsigned key)
+{
+	struct latency_button **list, *button;
+
+	for (list = &latency_list; *list != NULL && (*list)->key != key; list = &((*list)->next));
+
+	button = *list;
+	if (button == NULL)
+		return;
+
+	*list = button->next;
+
+	heap_free(button);
+}
+
+
+/**
+ * Write a report of the launch times for each button, slowest first, to
+ * a text file and open it for the user.
+ */
+
+void latency_show_report(void)
+{
+	FILE			*file;
+	struct latency_button	*button;
+	struct latency_rank	*ranks;
+	struct appdb_entry	app;
+	os_error		*error;
+	int			count = 0, i, j;
+	unsigned		hits, misses;
+
+	for (button = latency_list; button != NULL; button = button->next)
+		count++;
+
+	ranks = heap_alloc(((count > 0) ? count : 1) * sizeof(struct latency_rank));
+	if (ranks == NULL) {
+		error_msgs_report_error("NoMemReport");
+		return;
+	}
+
+	/* Rank the buttons by the 90th percentile of their time to start, or
+	 * of their time to dispatch if they haven't started any tasks.
+	 */
+
+	count = 0;
+
+	for (button = latency_list; button != NULL; button = button->next) {
+		if (appdb_get_button_info(button->key, NULL) == NULL)
+			continue;
+
+		ranks[count].button = button;
+		ranks[count].time = latency_get_percentile(&(button->series[LATENCY_CLICK_TO_START]), 90);
+
+		if (ranks[count].time < 0)
+			ranks[count].time = latency_get_percentile(&(button->series[LATENCY_CLICK_TO_DISPATCH]), 90);
+
+		count++;
+	}
+
+	qsort(ranks, count, sizeof(struct latency_rank), latency_compare_ranks);
+
+	/* Write the report. If the folder can't be created, the file can't
+	 * be opened either, so that's where the failure is reported.
+	 */
+
+	xosfile_create_dir(LATENCY_REPORT_DIR, 0);
+
+	file = fopen(LATENCY_REPORT_FILE, "w");
+	if (file == NULL) {
+		heap_free(ranks);
+		error_msgs_report_error("NoReport");
+		return;
+	}
+
+	panel_get_prefetch_counts(&hits, &misses);
+
+	fprintf(file, "Launcher launch times\n\n");
+	fprintf(file, "Launches started: %u, completed: %u, timed out: %u, failed: %u\n",
+			launch_get_outcome_count(LAUNCH_STATE_STARTED), launch_get_outcome_count(LAUNCH_STATE_COMPLETE),
+			launch_get_outcome_count(LAUNCH_STATE_TIMED_OUT), launch_get_outcome_count(LAUNCH_STATE_FAILED));
+	fprintf(file, "Prefetch hits: %u, misses: %u\n\n", hits, misses);
+	fprintf(file, "Times are in centiseconds, over the last %d launches of each button.\n\n", LATENCY_SAMPLES);
+
+	fprintf(file, "%-24s %8s   %-17s   %-17s   %-17s\n", "", "", "Click to dispatch", "Dispatch to start", "Click to start");
+	fprintf(file, "%-24s %8s", "Button", "Launches");
+	for (j = 0; j < LATENCY_INTERVALS; j++)
+		fprintf(file, "   %5s %5s %5s", "50%", "90%", "Max");
+	fprintf(file, "\n");
+
+	for (i = 0; i < count && i < LATENCY_REPORT_LIMIT; i++) {
+		button = ranks[i].button;
+
+		if (appdb_get_button_info(button->key, &app) == NULL)
+			continue;
+
+		fprintf(file, "%-24.24s %8u", app.name, button->series[LATENCY_CLICK_TO_DISPATCH].count);
+
+		for (j = 0; j < LATENCY_INTERVALS; j++)
+			latency_write_series(file, &(button->series[j]));
+
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
+	heap_free(ranks);
+
+	/* Open the report for the user. */
+
+	error = xosfile_set_type(LATENCY_REPORT_FILE, osfile_TYPE_TEXT);
+	if (error == NULL)
+		error = xos_cli("%Filer_Run " LATENCY_REPORT_FILE);
+
+	if (error != NULL)
+		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+}
+
+
+/**
+ * Find the latency records for a button.
+ *
+ * \param key		The database key of the button.
+ * \param create	TRUE to create new records if none exist.
+ * \return		Pointer to the records, or NULL.
+ */
+
+static struct latency_button *latency_find_button(unsigned key, osbool create)
+{
+	struct latency_button	*button;
+	int			i;
+
+	for (button = latency_list; button != NULL; button = button->next) {
+		if (button->key == key)
+			return button;
+	}
+
+	if (!create)
+		return NULL;
+
+	button = heap_alloc(sizeof(struct latency_button));
+	if (button == NULL)
+		return NULL;
+
+	button->key = key;
+
+	for (i = 0; i < LATENCY_INTERVALS; i++)
+		button->series[i].count = 0;
+
+	button->next = latency_list;
+	latency_list = button;
+
+	return button;
+}
+
+
+/**
+ * Calculate a percentile of the samples held for an interval.
+ *
+ * \param *series	The samples to process.
+ * \param percentile	The percentile to calculate, from 0 to 100.
+ * \return		The percentile, in centiseconds, or -1 if there
+ *			are no samples.
+ */
+
+static int latency_get_percentile(struct latency_series *series, int percentile)
+{
+	int samples[LATENCY_SAMPLES], count, i;
+
+	count = (series->count < LATENCY_SAMPLES) ? series->count : LATENCY_SAMPLES;
+	if (count == 0)
+		return -1;
+
+	for (i = 0; i < count; i++)
+		samples[i] = series->samples[i];
+
+	qsort(samples, count, sizeof(int), latency_compare_samples);
+
+	return samples[((count - 1) * percentile) / 100];
+}
+
+
+/**
+ * Write the median, 90th percentile and maximum of an interval to the
+ * report.
+ *
+ * \param *file		The file to write to.
+ * \param *series	The samples to report on.
+ */
+
+static void latency_write_series(FILE *file, struct latency_series *series)
+{
+	if (series->count == 0) {
+		fprintf(file, "   %5s %5s %5s", "-", "-", "-");
+		return;
+	}
+
+	fprintf(file, "   %5d %5d %5d", latency_get_percentile(series, 50),
+			latency_get_percentile(series, 90), latency_get_percentile(series, 100));
+}
+
+
+/**
+ * Compare two report ranks, so that the slowest buttons sort first.
+ *
+ * \param *a		The first rank to compare.
+ * \param *b		The second rank to compare.
+ * \return		The result of the comparison.
+ */
+
+static int latency_compare_ranks(const void *a, const void *b)
+{
+	return ((struct latency_rank *) b)->time - ((struct latency_rank *) a)->time;
+}
+
+
+/**
+ * Compare two samples, so that they sort into ascending order.
+ *
+ * \param *a		The first sample to compare.
+ * \param *b		The second sample to compare.
+ * \return		The result of the comparison.
+ */
+
+static int latency_compare_samples(const void *a, const void *b)
+{
+	return *((int *) a) - *((int *) b);
+}
+
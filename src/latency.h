@@ -0,0 +1,81 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: latency.h
+ *
+ * Launch latency records, holding the most recent launch times for each
+ * button so that slow targets can be identified.
+ */
+
+#ifndef LAUNCHER_LATENCY
+#define LAUNCHER_LATENCY
+
+/**
+ * The intervals which are timed during a launch.
+ */
+
+enum latency_interval {
+	LATENCY_CLICK_TO_DISPATCH = 0,	/**< From the click to the command being run.		*/
+	LATENCY_DISPATCH_TO_START,	/**< From the command being run to the task starting.	*/
+	LATENCY_CLICK_TO_START,		/**< From the click to the task starting.		*/
+	LATENCY_INTERVALS		/**< The number of intervals which are timed.		*/
+};
+
+
+/**
+ * Terminate the latency records, freeing their memory.
+ */
+
+void latency_terminate(void);
+
+
+/**
+ * Record the time taken by one interval of a button's launch.
+ *
+ * \param key		The database key of the button.
+ * \param interval	The interval which was timed.
+ * \param time		The time taken, in centiseconds.
+ */
+
+void latency_record(unsigned key, enum latency_interval interval, int time);
+
+
+/**
+ * Discard the latency records for a button, when it is deleted.
+ *
+ * \param key		The database key of the button.
+ */
+
+void latency_forget(unsigned key);
+
+
+/**
+ * Write a report of the launch times for each button, slowest first, to
+ * a text file and open it for the user.
+ */
+
+void latency_show_report(void);
+
+#endif
+
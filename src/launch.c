@@ -0,0 +1,628 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: launch.c
+ */
+
+/* ANSI C header files. */
+
+#include <stddef.h>
+
+/* OSLib header files. */
+
+#include "oslib/os.h"
+#include "oslib/wimp.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/errors.h"
+#include "sflib/event.h"
+#include "sflib/heap.h"
+
+/* Application header files. */
+
+#include "launch.h"
+
+#include "latency.h"
+#include "objutil.h"
+
+/**
+ * The time allowed for a new task to start after its command has been
+ * dispatched, in centiseconds.
+ */
+
+#define LAUNCH_TASK_TIMEOUT 300
+
+/**
+ * The number of icon bar icon handles to search when looking for a task's
+ * icon bar icon.
+ */
+
+#define LAUNCH_ICONBAR_ICONS 256
+
+/**
+ * A launch request.
+ */
+
+struct launch_request {
+	/**
+	 * The filename of the object to launch.
+	 */
+
+	char			*object;
+
+	/**
+	 * The cached details of the object to launch.
+	 */
+
+	struct objutil_target	target;
+
+	/**
+	 * The key identifying the request to the client.
+	 */
+
+	unsigned		key;
+
+	/**
+	 * The function to be told of changes of state, or NULL.
+	 */
+
+	launch_callback		callback;
+
+	/**
+	 * The time at which the user asked for the launch.
+	 */
+
+	os_t			requested;
+
+	/**
+	 * The time at which the command was dispatched.
+	 */
+
+	os_t			dispatched;
+
+	/**
+	 * The handle of the task started by the command, if Wimp_StartTask
+	 * returned one, or 0.
+	 */
+
+	wimp_t			task;
+
+	/**
+	 * Pointer to the next request in the list.
+	 */
+
+	struct launch_request	*next;
+};
+
+/**
+ * A task which was started by a launch request and is still running.
+ */
+
+struct launch_task {
+	/**
+	 * The handle of the task.
+	 */
+
+	wimp_t			task;
+
+	/**
+	 * The key of the request which started the task.
+	 */
+
+	unsigned		key;
+
+	/**
+	 * The function to be told when the task closes down, or NULL.
+	 */
+
+	launch_callback		callback;
+
+	/**
+	 * Pointer to the next task in the list.
+	 */
+
+	struct launch_task	*next;
+};
+
+/**
+ * The requests waiting to be dispatched, oldest first.
+ */
+
+static struct launch_request *launch_pending = NULL;
+
+/**
+ * The requests which have been dispatched and are waiting for their tasks
+ * to start, oldest first.
+ */
+
+static struct launch_request *launch_waiting = NULL;
+
+/**
+ * The number of requests which have finished in each state.
+ */
+
+static unsigned launch_outcomes[LAUNCH_STATE_MAX];
+
+/**
+ * The tasks started by launch requests which are still running, most
+ * recently started first.
+ */
+
+static struct launch_task *launch_running = NULL;
+
+/* Static Function Prototypes. */
+
+static osbool launch_message_task_initialise(wimp_message *message);
+static osbool launch_message_task_close_down(wimp_message *message);
+static struct launch_request *launch_match_task(wimp_t task);
+static void launch_dispatch(struct launch_request *request);
+static void launch_finish(struct launch_request *request, enum launch_state state);
+static void launch_append(struct launch_request **list, struct launch_request *request);
+
+
+/**
+ * Initialise the launch queue.
+ */
+
+void launch_initialise(void)
+{
+	int i;
+
+	for (i = 0; i < LAUNCH_STATE_MAX; i++)
+		launch_outcomes[i] = 0;
+
+	event_add_message_handler(message_TASK_INITIALISE, EVENT_MESSAGE_INCOMING, launch_message_task_initialise);
+	event_add_message_handler(message_TASK_CLOSE_DOWN, EVENT_MESSAGE_INCOMING, launch_message_task_close_down);
+}
+
+
+/**
+ * Terminate the launch queue, discarding any outstanding requests.
+ */
+
+void launch_terminate(void)
+{
+	struct launch_request	*request;
+	struct launch_task	*task;
+
+	while (launch_pending != NULL) {
+		request = launch_pending;
+		launch_pending = request->next;
+
+		heap_free(request->object);
+		heap_free(request);
+	}
+
+	while (launch_waiting != NULL) {
+		request = launch_waiting;
+		launch_waiting = request->next;
+
+		heap_free(request->object);
+		heap_free(request);
+	}
+
+	while (launch_running != NULL) {
+		task = launch_running;
+		launch_running = task->next;
+
+		heap_free(task);
+	}
+}
+
+
+/**
+ * Add a request to the launch queue. The request will be dispatched on a
+ * subsequent null poll.
+ *
+ * \param *object	The filename of the object to launch.
+ * \param *target	The cached details of the object to launch.
+ * \param key		A key to identify the request to the callback, and
+ *			the button in the latency records.
+ * \param requested	The time at which the user asked for the launch.
+ * \param callback	A function to be told about changes of state, or NULL.
+ * \return		TRUE if the request was queued; else FALSE.
+ */
+
+osbool launch_queue(char *object, struct objutil_target *target, unsigned key, os_t requested, launch_callback callback)
+{
+	struct launch_request *new;
+
+	if (object == NULL)
+		return FALSE;
+
+	new = heap_alloc(sizeof(struct launch_request));
+	if (new == NULL) {
+		error_msgs_report_error("NoMemLaunch");
+		return FALSE;
+	}
+
+	new->object = heap_strdup(object);
+	if (new->object == NULL) {
+		heap_free(new);
+		error_msgs_report_error("NoMemLaunch");
+		return FALSE;
+	}
+
+	if (target != NULL)
+		new->target = *target;
+	else
+		objutil_clear_target(&(new->target));
+
+	new->key = key;
+	new->callback = callback;
+	new->requested = requested;
+	new->dispatched = 0;
+	new->task = 0;
+	new->next = NULL;
+
+	launch_append(&launch_pending, new);
+
+	return TRUE;
+}
+
+
+/**
+ * Find out whether the launch queue has any work to do on null polls, and
+ * if so when it is next due.
+ *
+ * \param *time		Pointer to a variable to take the time at which a
+ *			null event is required.
+ * \return		TRUE if a null event is required; else FALSE.
+ */
+
+osbool launch_get_idle_time(os_t *time)
+{
+	if (time == NULL)
+		return FALSE;
+
+	/* Pending requests are dispatched as soon as possible. */
+
+	if (launch_pending != NULL) {
+		*time = os_read_monotonic_time();
+		return TRUE;
+	}
+
+	/* Otherwise, wake up when the oldest waiting request times out. */
+
+	if (launch_waiting != NULL) {
+		*time = launch_waiting->dispatched + LAUNCH_TASK_TIMEOUT;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+
+/**
+ * Dispatch the next request in the launch queue, and time out any requests
+ * which have been waiting too long for their tasks to start. This should
+ * be called from the poll loop on null events.
+ */
+
+void launch_process_idle(void)
+{
+	struct launch_request	*request;
+	os_t			now;
+
+	/* Only one request is dispatched on each poll, so that a burst of
+	 * clicks doesn't hold up the rest of the desktop.
+	 */
+
+	if (launch_pending != NULL) {
+		request = launch_pending;
+		launch_pending = request->next;
+		request->next = NULL;
+
+		launch_dispatch(request);
+	}
+
+	now = os_read_monotonic_time();
+
+	while (launch_waiting != NULL && (int) (now - launch_waiting->dispatched) >= LAUNCH_TASK_TIMEOUT) {
+		request = launch_waiting;
+		launch_waiting = request->next;
+
+		launch_finish(request, LAUNCH_STATE_TIMED_OUT);
+	}
+}
+
+
+/**
+ * Return the number of launch requests which have finished in a given
+ * state since the application started.
+ *
+ * \param state		The state to return the count for.
+ * \return		The number of requests which ended in that state.
+ */
+
+unsigned launch_get_outcome_count(enum launch_state state)
+{
+	if (state < 0 || state >= LAUNCH_STATE_MAX)
+		return 0;
+
+	return launch_outcomes[state];
+}
+
+
+/**
+ * Find a task which was started by a launch request and is still running.
+ *
+ * \param key		The key of the launch requests to look for.
+ * \return		The handle of the most recently started task, or
+ *			0 if none are running.
+ */
+
+wimp_t launch_get_running_task(unsigned key)
+{
+	struct launch_task *task;
+
+	for (task = launch_running; task != NULL; task = task->next) {
+		if (task->key == key)
+			return task->task;
+	}
+
+	return 0;
+}
+
+
+/**
+ * Bring a running task to the front, by clicking on its icon bar icon.
+ *
+ * \param task		The handle of the task to bring to the front.
+ * \return		TRUE if the task had an icon to click on; else FALSE.
+ */
+
+osbool launch_raise_task(wimp_t task)
+{
+	wimp_message	message;
+	wimp_pointer	pointer;
+	wimp_t		owner;
+	wimp_i		icon;
+
+	if (task == 0)
+		return FALSE;
+
+	/* Find the task's icon bar icon: an acknowledgement sent to an icon
+	 * isn't delivered, but returns the handle of the icon's owner, or
+	 * an error if the icon doesn't exist.
+	 */
+
+	message.size = 20;
+	message.your_ref = 0;
+	message.action = 0;
+
+	for (icon = 0; icon < LAUNCH_ICONBAR_ICONS; icon++) {
+		if (xwimp_send_message_to_window(wimp_USER_MESSAGE_ACKNOWLEDGE, &message, wimp_ICON_BAR, icon, &owner) == NULL && owner == task)
+			break;
+	}
+
+	if (icon >= LAUNCH_ICONBAR_ICONS)
+		return FALSE;
+
+	/* Click Select on the icon, as the user would to open its window. */
+
+	if (xwimp_get_pointer_info(&pointer) != NULL)
+		return FALSE;
+
+	pointer.buttons = wimp_CLICK_SELECT;
+	pointer.w = wimp_ICON_BAR;
+	pointer.i = icon;
+
+	return (xwimp_send_message(wimp_MOUSE_CLICK, (wimp_message *) &pointer, task) == NULL) ? TRUE : FALSE;
+}
+
+
+/**
+ * Handle incoming Message_TaskInitialise, by matching the new task to a
+ * request which is waiting for a task to start, and recording the task as
+ * running on behalf of the request.
+ *
+ * \param *message	The message data to be handled.
+ * \return		TRUE to claim the message; FALSE to pass it on.
+ */
+
+static osbool launch_message_task_initialise(wimp_message *message)
+{
+	struct launch_request	*request;
+	struct launch_task	*task;
+	os_t			now;
+
+	if (message == NULL)
+		return FALSE;
+
+	request = launch_match_task(message->sender);
+	if (request == NULL)
+		return FALSE;
+
+	/* If there's no memory to record the task, the launch still
+	 * counts; the task just won't be known to be running.
+	 */
+
+	task = heap_alloc(sizeof(struct launch_task));
+	if (task != NULL) {
+		task->task = message->sender;
+		task->key = request->key;
+		task->callback = request->callback;
+
+		task->next = launch_running;
+		launch_running = task;
+	}
+
+	now = os_read_monotonic_time();
+
+	latency_record(request->key, LATENCY_DISPATCH_TO_START, now - request->dispatched);
+	latency_record(request->key, LATENCY_CLICK_TO_START, now - request->requested);
+
+	launch_finish(request, LAUNCH_STATE_STARTED);
+
+	return FALSE;
+}
+
+
+/**
+ * Handle incoming Message_TaskCloseDown, by removing the task from the list
+ * of running tasks and informing the client of the request which started
+ * it.
+ *
+ * \param *message	The message data to be handled.
+ * \return		TRUE to claim the message; FALSE to pass it on.
+ */
+
+static osbool launch_message_task_close_down(wimp_message *message)
+{
+	struct launch_task	**list, *task;
+
+	if (message == NULL)
+		return FALSE;
+
+	list = &launch_running;
+
+	while (*list != NULL && (*list)->task != message->sender)
+		list = &((*list)->next);
+
+	if (*list == NULL)
+		return FALSE;
+
+	task = *list;
+	*list = task->next;
+
+	if (task->callback != NULL)
+		(task->callback)(task->key, LAUNCH_STATE_CLOSED, NULL);
+
+	heap_free(task);
+
+	return FALSE;
+}
+
+
+/**
+ * Find and remove the request which started a new task from the list of
+ * requests waiting for tasks to start. Only requests whose commands
+ * returned a task handle wait for a task, so the task must match the
+ * handle exactly.
+ *
+ * \param task		The handle of the new task.
+ * \return		The matching request, or NULL if there is none.
+ */
+
+static struct launch_request *launch_match_task(wimp_t task)
+{
+	struct launch_request **list, *request;
+
+	if (task == 0)
+		return NULL;
+
+	for (list = &launch_waiting; *list != NULL && (*list)->task != task; list = &((*list)->next));
+
+	request = *list;
+	if (request == NULL)
+		return NULL;
+
+	*list = request->next;
+	request->next = NULL;
+
+	return request;
+}
+
+
+/**
+ * Dispatch a launch request, running its command and then either adding
+ * it to the list of requests waiting for a task to start, or finishing it.
+ *
+ * \param *request	The request to dispatch.
+ */
+
+static void launch_dispatch(struct launch_request *request)
+{
+	if (request == NULL)
+		return;
+
+	request->dispatched = os_read_monotonic_time();
+
+	latency_record(request->key, LATENCY_CLICK_TO_DISPATCH, request->dispatched - request->requested);
+
+	if (!objutil_launch_target(request->object, &(request->target), &(request->task))) {
+		launch_finish(request, LAUNCH_STATE_FAILED);
+		return;
+	}
+
+	/* Opening a directory doesn't start a new task. If the command didn't
+	 * return a task handle, as with Filer_Run or a document opened in a
+	 * task which is already running, there's no way to tell which new
+	 * task, if any, belongs to it: guessing could mark the wrong button
+	 * as running, so the launch is treated as complete.
+	 */
+
+	if (request->target.type == OBJUTIL_TARGET_DIRECTORY || request->task == 0) {
+		launch_finish(request, LAUNCH_STATE_COMPLETE);
+		return;
+	}
+
+	if (request->callback != NULL)
+		(request->callback)(request->key, LAUNCH_STATE_DISPATCHED, &(request->target));
+
+	launch_append(&launch_waiting, request);
+}
+
+
+/**
+ * Finish a launch request, informing the client and freeing its memory.
+ * The request must already have been removed from any lists.
+ *
+ * \param *request	The request to finish.
+ * \param state		The state in which the request finished.
+ */
+
+static void launch_finish(struct launch_request *request, enum launch_state state)
+{
+	if (request == NULL)
+		return;
+
+	launch_outcomes[state]++;
+
+	if (request->callback != NULL)
+		(request->callback)(request->key, state, &(request->target));
+
+	heap_free(request->object);
+	heap_free(request);
+}
+
+
+/**
+ * Append a request to the end of a request list.
+ *
+ * \param **list	Pointer to the head of the list.
+ * \param *request	The request to append.
+ */
+
+static void launch_append(struct launch_request **list, struct launch_request *request)
+{
+	while (*list != NULL)
+		list = &((*list)->next);
+
+	request->next = NULL;
+	*list = request;
+}
+
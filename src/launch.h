@@ -0,0 +1,144 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: launch.h
+ *
+ * The launch queue, which takes launch requests from button clicks and
+ * starts them as new tasks one at a time on subsequent null polls, and
+ * keeps track of the tasks which they started until they close down.
+ */
+
+#ifndef LAUNCHER_LAUNCH
+#define LAUNCHER_LAUNCH
+
+#include "objutil.h"
+
+/**
+ * The states through which a launch request passes.
+ */
+
+enum launch_state {
+	LAUNCH_STATE_QUEUED = 0,	/**< The request is waiting to be dispatched.			*/
+	LAUNCH_STATE_DISPATCHED,	/**< The command has been run, and a new task is expected.	*/
+	LAUNCH_STATE_STARTED,		/**< The new task has started.					*/
+	LAUNCH_STATE_COMPLETE,		/**< The command has been run, and no task can be tracked.	*/
+	LAUNCH_STATE_TIMED_OUT,		/**< No new task started in the time allowed.			*/
+	LAUNCH_STATE_FAILED,		/**< The command could not be run.				*/
+	LAUNCH_STATE_CLOSED,		/**< The task started by the request has closed down.		*/
+	LAUNCH_STATE_MAX		/**< The number of launch states.				*/
+};
+
+/**
+ * A callback to be informed when a launch request changes state. The
+ * target, if supplied, holds the details of the object as found when it
+ * was launched.
+ */
+
+typedef void (*launch_callback)(unsigned key, enum launch_state state, struct objutil_target *target);
+
+
+/**
+ * Initialise the launch queue.
+ */
+
+void launch_initialise(void);
+
+
+/**
+ * Terminate the launch queue, discarding any outstanding requests.
+ */
+
+void launch_terminate(void);
+
+
+/**
+ * Add a request to the launch queue. The request will be dispatched on a
+ * subsequent null poll.
+ *
+ * \param *object	The filename of the object to launch.
+ * \param *target	The cached details of the object to launch.
+ * \param key		A key to identify the request to the callback, and
+ *			the button in the latency records.
+ * \param requested	The time at which the user asked for the launch.
+ * \param callback	A function to be told about changes of state, or NULL.
+ * \return		TRUE if the request was queued; else FALSE.
+ */
+
+osbool launch_queue(char *object, struct objutil_target *target, unsigned key, os_t requested, launch_callback callback);
+
+
+/**
+ * Find out whether the launch queue has any work to do on null polls, and
+ * if so when it is next due.
+ *
+ * \param *time		Pointer to a variable to take the time at which a
+ *			null event is required.
+ * \return		TRUE if a null event is required; else FALSE.
+ */
+
+osbool launch_get_idle_time(os_t *time);
+
+
+/**
+ * Dispatch the next request in the launch queue, and time out any requests
+ * which have been waiting too long for their tasks to start. This should
+ * be called from the poll loop on null events.
+ */
+
+void launch_process_idle(void);
+
+
+/**
+ * Return the number of launch requests which have finished in a given
+ * state since the application started.
+ *
+ * \param state		The state to return the count for.
+ * \return		The number of requests which ended in that state.
+ */
+
+unsigned launch_get_outcome_count(enum launch_state state);
+
+
+/**
+ * Find a task which was started by a launch request and is still running.
+ *
+ * \param key		The key of the launch requests to look for.
+ * \return		The handle of the most recently started task, or
+ *			0 if none are running.
+ */
+
+wimp_t launch_get_running_task(unsigned key);
+
+
+/**
+ * Bring a running task to the front, by clicking on its icon bar icon.
+ *
+ * \param task		The handle of the task to bring to the front.
+ * \return		TRUE if the task had an icon to click on; else FALSE.
+ */
+
+osbool launch_raise_task(wimp_t task);
+
+#endif
+
@@ -0,0 +1,935 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: layout.c
+ */
+
+/* ANSI C header files. */
+
+#include <stdlib.h>
+
+/* Application header files. */
+
+#include "layout.h"
+
+/* Static Function Prototypes. */
+
+static int layout_compare_panels(const void *p, const void *q);
+static int layout_divide_down(int value, int divisor);
+static int layout_get_long_size(struct layout_panel *panel);
+static void layout_update_transform(struct layout_panel *panel);
+
+
+/**
+ * Initialise a panel layout block with default values.
+ *
+ * \param *panel	The panel layout to initialise.
+ */
+
+void layout_initialise_panel(struct layout_panel *panel)
+{
+	if (panel == NULL)
+		return;
+
+	panel->location = LAYOUT_POSITION_LEFT;
+	panel->sort = 0;
+	panel->longitude_weight = 0;
+	panel->grid_depth = 0;
+	panel->grid_dimensions.x = 0;
+	panel->grid_dimensions.y = 0;
+	panel->origin.x = 0;
+	panel->origin.y = 0;
+	panel->min_longitude = 0;
+	panel->max_longitude = 0;
+	panel->grid_square = 0;
+	panel->grid_spacing = 0;
+	panel->slab_grid_dimensions.x = 0;
+	panel->slab_grid_dimensions.y = 0;
+	panel->slab_os_dimensions.x = 0;
+	panel->slab_os_dimensions.y = 0;
+	panel->extent.x0 = 0;
+	panel->extent.y0 = 0;
+	panel->extent.x1 = 0;
+	panel->extent.y1 = 0;
+	panel->sidebar.x0 = 0;
+	panel->sidebar.y0 = 0;
+	panel->sidebar.x1 = 0;
+	panel->sidebar.y1 = 0;
+	panel->scrolling = false;
+	panel->scroll = 0;
+
+	layout_update_transform(panel);
+}
+
+
+/**
+ * Share the available space along each edge of the screen between the
+ * panels located there, updating their minimum and maximum longitudes.
+ *
+ * \param *panels[]	An array of pointers to the panels to arrange; this
+ *			will be sorted into panel order on exit.
+ * \param count		The number of panels in the array.
+ * \param *screen	The details of the screen.
+ */
+
+void layout_arrange_panels(struct layout_panel *panels[], size_t count, struct layout_screen *screen)
+{
+	struct layout_box	locations, start_pos, next_pos, max_width, units, totals;
+	size_t			i;
+
+	if (panels == NULL || screen == NULL)
+		return;
+
+	/* Count the number of panels on each side of the screen.*/
+
+	locations.x0 = 0;
+	locations.x1 = 0;
+	locations.y0 = 0;
+	locations.y1 = 0;
+
+	/* Total the number of width units on each side of the screen. */
+
+	units.x0 = 0;
+	units.x1 = 0;
+	units.y0 = 0;
+	units.y1 = 0;
+
+	for (i = 0; i < count; i++) {
+		switch (panels[i]->location) {
+		case LAYOUT_POSITION_LEFT:
+			locations.x0++;
+			units.x0 += panels[i]->longitude_weight;
+			break;
+		case LAYOUT_POSITION_RIGHT:
+			locations.x1++;
+			units.x1 += panels[i]->longitude_weight;
+			break;
+		case LAYOUT_POSITION_TOP:
+			locations.y1++;
+			units.y1 += panels[i]->longitude_weight;
+			break;
+		case LAYOUT_POSITION_BOTTOM:
+			locations.y0++;
+			units.y0 += panels[i]->longitude_weight;
+			break;
+		case LAYOUT_POSITION_VERTICAL:
+		case LAYOUT_POSITION_HORIZONTAL:
+		case LAYOUT_POSITION_NONE:
+			break;
+		}
+	}
+
+	/* Sort the panels into order. */
+
+	qsort(panels, count, sizeof(struct layout_panel *), &layout_compare_panels);
+
+	/* The lowest position of the first bar on each side of the screen. */
+
+	start_pos.x0 = screen->iconbar_height;
+	start_pos.x1 = screen->iconbar_height;
+	start_pos.y0 = 0;
+	start_pos.y1 = 0;
+
+	/* The end-to-end distance for all the bars on each side of the screen. */
+
+	max_width.x0 = screen->mode_height - screen->iconbar_height;
+	max_width.x1 = screen->mode_height - screen->iconbar_height;
+	max_width.y0 = screen->mode_width;
+	max_width.y1 = screen->mode_width;
+
+	/* If there's a bar on the left, push the top and bottom bars in. */
+
+	if (locations.x0 > 0) {
+		start_pos.y0 += screen->sidebar_width;
+		start_pos.y1 += screen->sidebar_width;
+
+		max_width.y0 -= screen->sidebar_width;
+		max_width.y1 -= screen->sidebar_width;
+	}
+
+	/* If there's a bar on the right, pull the top and bottom bars back. */
+
+	if (locations.x1 > 0) {
+		max_width.y0 -= screen->sidebar_width;
+		max_width.y1 -= screen->sidebar_width;
+	}
+
+	/* If there's a bar at the bottum, push the left and right bars up. */
+
+	if (locations.y0 > 0) {
+		start_pos.x0 += screen->sidebar_height;
+		start_pos.x1 += screen->sidebar_height;
+
+		max_width.x0 -= screen->sidebar_height;
+		max_width.x1 -= screen->sidebar_height;
+	}
+
+	/* If there's a bar at the top, pull the left and right bars down. */
+
+	if (locations.y1 > 0) {
+		max_width.x0 -= screen->sidebar_height;
+		max_width.x1 -= screen->sidebar_height;
+	}
+
+	/* Track the start of the next bar on each side of the screen. */
+
+	next_pos.x0 = start_pos.x0;
+	next_pos.x1 = start_pos.x1;
+	next_pos.y0 = start_pos.y0;
+	next_pos.y1 = start_pos.y1;
+
+	/* Count the number of width weight units seen so far. */
+
+	totals.x0 = 0;
+	totals.x1 = 0;
+	totals.y0 = 0;
+	totals.y1 = 0;
+
+	/* Update the min and max extent for each bar. */
+
+	for (i = 0; i < count; i++) {
+		switch (panels[i]->location) {
+		case LAYOUT_POSITION_LEFT:
+			totals.x0 += panels[i]->longitude_weight;
+			panels[i]->min_longitude = next_pos.x0;
+
+			panels[i]->max_longitude = ((totals.x0 * max_width.x0) / units.x0) + start_pos.x0;
+			next_pos.x0 = panels[i]->max_longitude + screen->y_units_per_pixel;
+			break;
+		case LAYOUT_POSITION_RIGHT:
+			totals.x1 += panels[i]->longitude_weight;
+			panels[i]->min_longitude = next_pos.x1;
+
+			panels[i]->max_longitude = ((totals.x1 * max_width.x1) / units.x1) + start_pos.x1;
+			next_pos.x1 = panels[i]->max_longitude + screen->y_units_per_pixel;
+			break;
+		case LAYOUT_POSITION_TOP:
+			totals.y1 += panels[i]->longitude_weight;
+			panels[i]->min_longitude = next_pos.y1;
+
+			panels[i]->max_longitude = ((totals.y1 * max_width.y1) / units.y1) + start_pos.y1;
+			next_pos.y1 = panels[i]->max_longitude + screen->x_units_per_pixel;
+			break;
+		case LAYOUT_POSITION_BOTTOM:
+			totals.y0 += panels[i]->longitude_weight;
+			panels[i]->min_longitude = next_pos.y0;
+
+			panels[i]->max_longitude = ((totals.y0 * max_width.y0) / units.y0) + start_pos.y0;
+			next_pos.y0 = panels[i]->max_longitude + screen->x_units_per_pixel;
+			break;
+		case LAYOUT_POSITION_VERTICAL:
+		case LAYOUT_POSITION_HORIZONTAL:
+		case LAYOUT_POSITION_NONE:
+			break;
+		}
+	}
+}
+
+
+/**
+ * Compare two entries in an array of pointers to panel layouts.
+ * Used as a callback function for qsort().
+ *
+ * \param *p			Pointer to the first array entry.
+ * \param *q			Pointer to the second array entry.
+ * \return			-1, 0 or +1 depending on sort order.
+ */
+
+static int layout_compare_panels(const void *p, const void *q)
+{
+	const struct layout_panel * const *a = p;
+	const struct layout_panel * const *b = q;
+
+	if (a == NULL || *a == NULL || b == NULL || *b == NULL)
+		return 0;
+
+	return ((*a)->sort > (*b)->sort) - ((*a)->sort < (*b)->sort);
+}
+
+
+/**
+ * Update the grid details for a panel from the user's choices.
+ *
+ * \param *panel	The panel layout to update.
+ * \param grid_square	The size of a grid square, in OS units.
+ * \param grid_spacing	The spacing between grid squares, in OS units.
+ * \param depth		The configured depth of the panel, in grid squares.
+ * \param *slab_size	The size of a button slab, in grid squares.
+ */
+
+void layout_set_grid(struct layout_panel *panel, int grid_square, int grid_spacing, int depth, struct layout_coord *slab_size)
+{
+	if (panel == NULL || slab_size == NULL)
+		return;
+
+	panel->grid_square = grid_square;
+	panel->grid_spacing = grid_spacing;
+	panel->grid_depth = depth;
+	panel->slab_grid_dimensions.x = slab_size->x;
+	panel->slab_grid_dimensions.y = slab_size->y;
+
+	/* Update the slab size in OS units. */
+
+	panel->slab_os_dimensions.x = (panel->slab_grid_dimensions.x * (panel->grid_spacing + panel->grid_square))
+			- panel->grid_spacing;
+	panel->slab_os_dimensions.y = (panel->slab_grid_dimensions.y * (panel->grid_spacing + panel->grid_square))
+			- panel->grid_spacing;
+
+	/* Calculate the number of rows in the panel at the current slab size. */
+
+	panel->grid_dimensions.x = panel->grid_depth;
+
+	if (panel->grid_square + panel->grid_spacing != 0)
+		panel->grid_dimensions.y = (panel->max_longitude - panel->min_longitude) /
+				(panel->grid_square + panel->grid_spacing);
+	else
+		panel->grid_dimensions.y = 0;
+}
+
+
+/**
+ * Reflow the buttons in a panel, to reflect the available space on the
+ * grid, updating the grid dimensions to include any overflow.
+ *
+ * \param *panel	The panel layout to use.
+ * \param buttons[]	The buttons to reflow, in position order.
+ * \param count		The number of buttons in the array.
+ */
+
+void layout_reflow_buttons(struct layout_panel *panel, struct layout_button buttons[], size_t count)
+{
+	struct layout_button	*button, *previous;
+	struct layout_coord	overflow;
+	bool			clash;
+	int			rows;
+	size_t			i, j;
+
+	if (panel == NULL || (buttons == NULL && count > 0))
+		return;
+
+	/* Start the grid at the configured width. */
+
+	panel->grid_dimensions.x = panel->grid_depth;
+	rows = panel->grid_dimensions.y;
+
+	/* Start to place overflow buttons top-left. */
+
+	overflow.x = 0;
+	overflow.y = 0;
+
+	/* Process the icons. */
+
+	for (i = 0; i < count; i++) {
+		button = buttons + i;
+
+		button->position.x = button->ideal.x;
+		button->position.y = button->ideal.y;
+
+		/* Do a bounds check on all the buttons above and to the left. */
+
+		for (j = 0; j < i; j++) {
+			previous = buttons + j;
+
+			if ((button->position.x > previous->position.x) &&
+					(button->position.x < (previous->position.x + panel->slab_grid_dimensions.x)) &&
+					(button->position.y >= previous->position.y) &&
+					(button->position.y < (previous->position.y + panel->slab_grid_dimensions.y))) {
+				button->position.x = previous->position.x + panel->slab_grid_dimensions.x;
+			}
+
+			if ((button->position.y >= previous->position.y) &&
+					(button->position.y < (previous->position.y + panel->slab_grid_dimensions.y)) &&
+					(button->position.x > (previous->position.x - panel->slab_grid_dimensions.x)) &&
+					(button->position.x <= previous->position.x)) {
+				button->position.y = previous->position.y + panel->slab_grid_dimensions.y;
+			}
+		}
+
+		/* On a scrolling panel, buttons outside the configured rows just
+		 * extend the panel along its long axis.
+		 */
+
+		if (panel->scrolling) {
+			if ((button->position.y + panel->slab_grid_dimensions.y) > rows)
+				rows = button->position.y + panel->slab_grid_dimensions.y;
+		}
+
+		/* Does the button fall outside the configured rows?
+		 *
+		 * We know by now that we've reached the bottom of the grid in all
+		 * columns, due to the sort order, so we're just looking for spaces
+		 * in the layout working right in columns from top to bottom.
+		 */
+
+		else if ((button->position.y + panel->slab_grid_dimensions.y) > panel->grid_dimensions.y) {
+			do {
+				clash = false;
+
+				for (j = 0; j < i; j++) {
+					previous = buttons + j;
+
+					if ((overflow.x > (previous->position.x - panel->slab_grid_dimensions.x)) &&
+							(overflow.x < (previous->position.x + panel->slab_grid_dimensions.x)) &&
+							(overflow.y > (previous->position.y - panel->slab_grid_dimensions.y)) &&
+							(overflow.y < (previous->position.y + panel->slab_grid_dimensions.y)))
+						clash = true;
+				}
+
+				if (clash) {
+					overflow.y++;
+
+					if ((overflow.y + panel->slab_grid_dimensions.y) > panel->grid_dimensions.y) {
+						overflow.x++;
+						overflow.y = 0;
+					}
+				}
+			} while (clash);
+
+			button->position.x = overflow.x;
+			button->position.y = overflow.y;
+		}
+
+		/* Does the button fall outside the colfigured columns? */
+
+		if ((button->position.x + panel->slab_grid_dimensions.x) > panel->grid_dimensions.x)
+			panel->grid_dimensions.x = button->position.x + panel->slab_grid_dimensions.x;
+	}
+
+	panel->grid_dimensions.y = rows;
+}
+
+
+/**
+ * Calculate the window extent, grid origin and sidebar extent for a panel.
+ *
+ * \param *panel	The panel layout to update.
+ * \param *screen	The details of the screen.
+ */
+
+void layout_set_extent(struct layout_panel *panel, struct layout_screen *screen)
+{
+	int			new_window_size;
+	struct layout_box	*extent;
+
+	if (panel == NULL || screen == NULL)
+		return;
+
+	extent = &(panel->extent);
+
+	new_window_size = layout_get_long_size(panel);
+
+	if (panel->location & LAYOUT_POSITION_VERTICAL) {
+
+		/* Calculate the new vertical size of the window. */
+
+		extent->y1 = 0;
+		extent->y0 = extent->y1 - new_window_size;
+
+		/* Calculate the new horizontal size of the window. */
+
+		extent->x0 = 0;
+		extent->x1 = extent->x0 + screen->sidebar_width + panel->grid_spacing +
+				panel->grid_dimensions.x * (panel->grid_spacing + panel->grid_square);
+	} else if (panel->location & LAYOUT_POSITION_HORIZONTAL) {
+
+		/* Calculate the new horizontal size of the window. */
+
+		extent->x0 = 0;
+		extent->x1 = extent->x0 + new_window_size;
+
+		/* Calculate the new vertical size of the window. */
+
+		extent->y1 = 0;
+		extent->y0 = extent->y1 - screen->sidebar_height - panel->grid_spacing -
+				panel->grid_dimensions.x * (panel->grid_spacing + panel->grid_square);
+	}
+
+	/* Find the grid origin and the location of the sidebar icon. */
+
+	switch (panel->location) {
+	case LAYOUT_POSITION_LEFT:
+		panel->origin.x = extent->x1 - panel->grid_spacing - screen->sidebar_width;
+		panel->origin.y = extent->y1 - panel->grid_spacing;
+
+		panel->sidebar.x0 = extent->x1 - screen->sidebar_width;
+		panel->sidebar.y0 = extent->y0;
+		panel->sidebar.x1 = extent->x1;
+		panel->sidebar.y1 = extent->y1;
+		break;
+
+	case LAYOUT_POSITION_RIGHT:
+		panel->origin.x = extent->x0 + panel->grid_spacing + screen->sidebar_width;
+		panel->origin.y = extent->y1 - panel->grid_spacing;
+
+		panel->sidebar.x0 = extent->x0;
+		panel->sidebar.y0 = extent->y0;
+		panel->sidebar.x1 = extent->x0 + screen->sidebar_width;
+		panel->sidebar.y1 = extent->y1;
+		break;
+
+	case LAYOUT_POSITION_TOP:
+		panel->origin.x = extent->x0 + panel->grid_spacing;
+		panel->origin.y = extent->y0 + panel->grid_spacing + screen->sidebar_height;
+
+		panel->sidebar.x0 = extent->x0;
+		panel->sidebar.y0 = extent->y0;
+		panel->sidebar.x1 = extent->x1;
+		panel->sidebar.y1 = extent->y0 + screen->sidebar_height;
+		break;
+
+	case LAYOUT_POSITION_BOTTOM:
+		panel->origin.x = extent->x0 + panel->grid_spacing;
+		panel->origin.y = extent->y1 - panel->grid_spacing - screen->sidebar_height;
+
+		panel->sidebar.x0 = extent->x0;
+		panel->sidebar.y0 = extent->y1 - screen->sidebar_height;
+		panel->sidebar.x1 = extent->x1;
+		panel->sidebar.y1 = extent->y1;
+		break;
+
+	case LAYOUT_POSITION_HORIZONTAL:
+	case LAYOUT_POSITION_VERTICAL:
+	case LAYOUT_POSITION_NONE:
+		break;
+	}
+
+	/* Update the grid transform for the new origin, and keep the scroll
+	 * offset within the new extent.
+	 */
+
+	layout_update_transform(panel);
+	layout_set_scroll(panel, panel->scroll);
+}
+
+
+/**
+ * Calculate the visible area and scroll offsets of a panel window, either
+ * open to show its buttons or closed down to just its sidebar.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *screen	The details of the screen.
+ * \param open		true to calculate the open state; false for closed.
+ * \param *visible	Pointer to a box to take the visible area.
+ * \param *scroll	Pointer to a coordinate to take the scroll offsets.
+ */
+
+void layout_get_open_box(struct layout_panel *panel, struct layout_screen *screen, bool open, struct layout_box *visible, struct layout_coord *scroll)
+{
+	int	grid_size, sidebar_size, open_size;
+
+	if (panel == NULL || screen == NULL || visible == NULL || scroll == NULL)
+		return;
+
+	grid_size = panel->grid_spacing + (panel->grid_dimensions.x * (panel->grid_spacing + panel->grid_square));
+
+	visible->x0 = 0;
+	visible->y0 = 0;
+	visible->x1 = 0;
+	visible->y1 = 0;
+
+	scroll->x = 0;
+	scroll->y = 0;
+
+	switch (panel->location) {
+	case LAYOUT_POSITION_LEFT:
+		sidebar_size = panel->sidebar.x1 - panel->sidebar.x0;
+		open_size = ((open) ? grid_size : 0) + sidebar_size;
+
+		visible->x0 = 0;
+		visible->x1 = open_size;
+		visible->y0 = panel->min_longitude;
+		visible->y1 = panel->max_longitude;
+
+		scroll->x = (open) ? 0 : grid_size;
+		scroll->y = -panel->scroll;
+		break;
+
+	case LAYOUT_POSITION_RIGHT:
+		sidebar_size = panel->sidebar.x1 - panel->sidebar.x0;
+		open_size = ((open) ? grid_size : 0) + sidebar_size;
+
+		visible->x0 = screen->mode_width - open_size;
+		visible->x1 = screen->mode_width;
+		visible->y0 = panel->min_longitude;
+		visible->y1 = panel->max_longitude;
+
+		scroll->y = -panel->scroll;
+		break;
+
+	case LAYOUT_POSITION_TOP:
+		sidebar_size = panel->sidebar.y1 - panel->sidebar.y0;
+		open_size = ((open) ? grid_size : 0) + sidebar_size;
+
+		visible->x0 = panel->min_longitude;
+		visible->x1 = panel->max_longitude;
+		visible->y0 = screen->mode_height - open_size;
+		visible->y1 = screen->mode_height;
+
+		scroll->x = panel->scroll;
+		scroll->y = (open) ? 0 : -grid_size;
+		break;
+
+	case LAYOUT_POSITION_BOTTOM:
+		sidebar_size = panel->sidebar.y1 - panel->sidebar.y0;
+		open_size = ((open) ? grid_size : 0) + sidebar_size;
+
+		visible->x0 = panel->min_longitude;
+		visible->x1 = panel->max_longitude;
+		visible->y0 = screen->iconbar_height;
+		visible->y1 = screen->iconbar_height + open_size;
+
+		scroll->x = panel->scroll;
+		break;
+
+	case LAYOUT_POSITION_HORIZONTAL:
+	case LAYOUT_POSITION_VERTICAL:
+	case LAYOUT_POSITION_NONE:
+		break;
+	}
+}
+
+
+/**
+ * Calculate the extent of a button's icon within the panel work area.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *position	The button's grid position.
+ * \param *extent	Pointer to a box to take the icon extent.
+ */
+
+void layout_get_button_extent(struct layout_panel *panel, struct layout_coord *position, struct layout_box *extent)
+{
+	struct layout_transform	*t;
+	struct layout_coord	start, end;
+	int			pitch, column, row;
+
+	if (panel == NULL || position == NULL || extent == NULL)
+		return;
+
+	t = &(panel->transform);
+	pitch = panel->grid_square + panel->grid_spacing;
+
+	/* Find the corner of the slab at the grid position, and the corner
+	 * diagonally opposite it.
+	 */
+
+	column = position->x * pitch;
+	row = position->y * pitch;
+
+	start.x = t->origin.x + (column * t->column.x) + (row * t->row.x);
+	start.y = t->origin.y + (column * t->column.y) + (row * t->row.y);
+
+	end.x = start.x + (panel->slab_os_dimensions.x * t->column.x) + (panel->slab_os_dimensions.y * t->row.x);
+	end.y = start.y + (panel->slab_os_dimensions.x * t->column.y) + (panel->slab_os_dimensions.y * t->row.y);
+
+	extent->x0 = (start.x < end.x) ? start.x : end.x;
+	extent->x1 = (start.x < end.x) ? end.x : start.x;
+	extent->y0 = (start.y < end.y) ? start.y : end.y;
+	extent->y1 = (start.y < end.y) ? end.y : start.y;
+}
+
+
+/**
+ * Find the grid cell containing a point in the panel work area.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *point	The work area coordinates of the point.
+ * \param *cell		Pointer to a coordinate to take the grid cell.
+ */
+
+void layout_get_grid_cell(struct layout_panel *panel, struct layout_coord *point, struct layout_coord *cell)
+{
+	struct layout_transform	*t;
+	struct layout_coord	offset;
+	int			pitch;
+
+	if (panel == NULL || point == NULL || cell == NULL)
+		return;
+
+	t = &(panel->transform);
+	pitch = panel->grid_square + panel->grid_spacing;
+
+	offset.x = point->x - t->origin.x;
+	offset.y = point->y - t->origin.y;
+
+	cell->x = (offset.x * t->column.x) + (offset.y * t->column.y);
+	cell->y = (offset.x * t->row.x) + (offset.y * t->row.y);
+
+	if (pitch != 0) {
+		cell->x /= pitch;
+		cell->y /= pitch;
+	}
+}
+
+
+/**
+ * Calculate the range of grid rows, along the long axis of a panel, whose
+ * buttons might intersect an area of the panel work area. The range is
+ * conservative, and the buttons returned must still be tested against the
+ * area itself.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *area		The area of the work area to test.
+ * \param *first	Pointer to a variable to take the first row.
+ * \param *last		Pointer to a variable to take the last row.
+ * \return		true if any rows might intersect; else false.
+ */
+
+bool layout_get_row_range(struct layout_panel *panel, struct layout_box *area, int *first, int *last)
+{
+	struct layout_transform	*t;
+	int			pitch, low, high, swap;
+
+	if (panel == NULL || area == NULL || first == NULL || last == NULL)
+		return false;
+
+	t = &(panel->transform);
+	pitch = panel->grid_square + panel->grid_spacing;
+	if (pitch <= 0 || (t->row.x == 0 && t->row.y == 0))
+		return false;
+
+	/* Find the offsets of the area's corners along the long axis, measured
+	 * from the origin in the direction of increasing row number. A button
+	 * extends a slab length along the axis from the start of its row.
+	 */
+
+	low = ((area->x0 - t->origin.x) * t->row.x) + ((area->y0 - t->origin.y) * t->row.y);
+	high = ((area->x1 - t->origin.x) * t->row.x) + ((area->y1 - t->origin.y) * t->row.y);
+
+	if (low > high) {
+		swap = low;
+		low = high;
+		high = swap;
+	}
+
+	*first = layout_divide_down(low - panel->slab_os_dimensions.y, pitch);
+	*last = layout_divide_down(high, pitch);
+
+	if (*first < 0)
+		*first = 0;
+
+	return (*last >= *first) ? true : false;
+}
+
+
+/**
+ * Set the scroll offset of a panel along its long axis, limiting it to
+ * the available work area.
+ *
+ * \param *panel	The panel layout to update.
+ * \param scroll	The required scroll offset, in OS units.
+ * \return		true if the scroll offset changed; else false.
+ */
+
+bool layout_set_scroll(struct layout_panel *panel, int scroll)
+{
+	int limit, previous;
+
+	if (panel == NULL)
+		return false;
+
+	limit = layout_get_long_size(panel) - (panel->max_longitude - panel->min_longitude);
+
+	if (!panel->scrolling || scroll < 0 || limit < 0)
+		scroll = 0;
+	else if (scroll > limit)
+		scroll = limit;
+
+	previous = panel->scroll;
+	panel->scroll = scroll;
+
+	return (scroll != previous) ? true : false;
+}
+
+
+/**
+ * Calculate the range of grid rows which are visible in a panel at its
+ * current scroll offset, extended by a margin at each end.
+ *
+ * \param *panel	The panel layout to use.
+ * \param margin	The number of extra rows to include at each end.
+ * \param *first	Pointer to a variable to take the first row.
+ * \param *last		Pointer to a variable to take the last row.
+ * \return		true if any rows are visible; else false.
+ */
+
+bool layout_get_visible_rows(struct layout_panel *panel, int margin, int *first, int *last)
+{
+	struct layout_box	area;
+	int			extra;
+
+	if (panel == NULL)
+		return false;
+
+	area = panel->extent;
+	extra = margin * (panel->grid_square + panel->grid_spacing);
+
+	if (panel->location & LAYOUT_POSITION_VERTICAL) {
+		area.y1 = panel->extent.y1 - panel->scroll + extra;
+		area.y0 = area.y1 - (panel->max_longitude - panel->min_longitude) - (2 * extra);
+	} else if (panel->location & LAYOUT_POSITION_HORIZONTAL) {
+		area.x0 = panel->extent.x0 + panel->scroll - extra;
+		area.x1 = area.x0 + (panel->max_longitude - panel->min_longitude) + (2 * extra);
+	}
+
+	return layout_get_row_range(panel, &area, first, last);
+}
+
+
+/**
+ * Calculate the length of a panel's work area along its long axis. This is
+ * the space available on the screen, unless the panel scrolls and its
+ * buttons need more room.
+ *
+ * \param *panel	The panel layout to use.
+ * \return		The length of the work area, in OS units.
+ */
+
+static int layout_get_long_size(struct layout_panel *panel)
+{
+	int size, needed;
+
+	size = panel->max_longitude - panel->min_longitude;
+
+	if (panel->scrolling) {
+		needed = panel->grid_spacing + (panel->grid_dimensions.y * (panel->grid_square + panel->grid_spacing));
+
+		if (needed > size)
+			size = needed;
+	}
+
+	return size;
+}
+
+
+/**
+ * Update the transform between grid offsets and work area coordinates for
+ * a panel, from its location and grid origin.
+ *
+ * \param *panel	The panel layout to update.
+ */
+
+static void layout_update_transform(struct layout_panel *panel)
+{
+	struct layout_transform *t = &(panel->transform);
+
+	t->origin = panel->origin;
+
+	t->column.x = 0;
+	t->column.y = 0;
+	t->row.x = 0;
+	t->row.y = 0;
+
+	switch (panel->location) {
+	case LAYOUT_POSITION_LEFT:
+		t->column.x = -1;
+		t->row.y = -1;
+		break;
+
+	case LAYOUT_POSITION_RIGHT:
+		t->column.x = 1;
+		t->row.y = -1;
+		break;
+
+	case LAYOUT_POSITION_TOP:
+		t->column.y = 1;
+		t->row.x = 1;
+		break;
+
+	case LAYOUT_POSITION_BOTTOM:
+		t->column.y = -1;
+		t->row.x = 1;
+		break;
+
+	case LAYOUT_POSITION_HORIZONTAL:
+	case LAYOUT_POSITION_VERTICAL:
+	case LAYOUT_POSITION_NONE:
+		break;
+	}
+}
+
+
+/**
+ * Divide one integer by another, rounding towards negative infinity.
+ *
+ * \param value		The value to be divided.
+ * \param divisor	The divisor, which must be positive.
+ * \return		The rounded result.
+ */
+
+static int layout_divide_down(int value, int divisor)
+{
+	return (value >= 0) ? value / divisor : -((divisor - 1 - value) / divisor);
+}
+
+
+/**
+ * Test whether any of the inputs which determine a panel's geometry have
+ * changed between two layouts. The edge, weight and sort order of the panel
+ * are tested through the longitudes which they produce.
+ *
+ * \param *panel	The new panel layout.
+ * \param *previous	The previous panel layout.
+ * \return		true if the geometry inputs differ; else false.
+ */
+
+bool layout_panel_changed(struct layout_panel *panel, struct layout_panel *previous)
+{
+	if (panel == NULL || previous == NULL)
+		return true;
+
+	return (panel->location != previous->location ||
+			panel->min_longitude != previous->min_longitude ||
+			panel->max_longitude != previous->max_longitude ||
+			panel->grid_square != previous->grid_square ||
+			panel->grid_spacing != previous->grid_spacing ||
+			panel->grid_depth != previous->grid_depth ||
+			panel->scrolling != previous->scrolling ||
+			panel->slab_grid_dimensions.x != previous->slab_grid_dimensions.x ||
+			panel->slab_grid_dimensions.y != previous->slab_grid_dimensions.y) ? true : false;
+}
+
+
+/**
+ * Test whether any of the screen details have changed between two screen
+ * descriptions.
+ *
+ * \param *screen	The new screen details.
+ * \param *previous	The previous screen details.
+ * \return		true if the details differ; else false.
+ */
+
+bool layout_screen_changed(struct layout_screen *screen, struct layout_screen *previous)
+{
+	if (screen == NULL || previous == NULL)
+		return true;
+
+	return (screen->mode_width != previous->mode_width ||
+			screen->mode_height != previous->mode_height ||
+			screen->iconbar_height != previous->iconbar_height ||
+			screen->x_units_per_pixel != previous->x_units_per_pixel ||
+			screen->y_units_per_pixel != previous->y_units_per_pixel ||
+			screen->sidebar_width != previous->sidebar_width ||
+			screen->sidebar_height != previous->sidebar_height) ? true : false;
+}
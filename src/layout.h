@@ -0,0 +1,440 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: layout.h
+ *
+ * Panel layout calculations. Nothing in this module makes any calls to
+ * the Wimp or the OS: it takes the details of the panels, their buttons,
+ * the screen mode and the user's choices, and returns the window extents,
+ * origins and icon rectangles which result.
+ *
+ * The module depends on nothing beyond the C library, so that it can also
+ * be built and tested on the host: see the test directory.
+ */
+
+#ifndef LAUNCHER_LAYOUT
+#define LAUNCHER_LAYOUT
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * A point or size on the screen or a panel grid.
+ */
+
+struct layout_coord {
+	int x;
+	int y;
+};
+
+/**
+ * A rectangle on the screen or in a panel work area.
+ */
+
+struct layout_box {
+	int x0;
+	int y0;
+	int x1;
+	int y1;
+};
+
+/**
+ * The position of a button on a panel grid.
+ */
+
+struct layout_button {
+	/**
+	 * The requested position of the button, before reflowing.
+	 */
+
+	struct layout_coord ideal;
+
+	/**
+	 * The actual position of the button, after reflowing.
+	 */
+
+	struct layout_coord position;
+};
+
+/**
+ * The possible panel positions.
+ */
+
+enum layout_position {
+	LAYOUT_POSITION_NONE = 0,
+	LAYOUT_POSITION_LEFT = 1,
+	LAYOUT_POSITION_RIGHT = 2,
+	LAYOUT_POSITION_VERTICAL = 3,
+	LAYOUT_POSITION_TOP = 4,
+	LAYOUT_POSITION_BOTTOM = 8,
+	LAYOUT_POSITION_HORIZONTAL = 12
+};
+
+/**
+ * The details of the screen on which the panels are laid out.
+ */
+
+struct layout_screen {
+	/**
+	 * The width of the current mode, in OS Units.
+	 */
+
+	int mode_width;
+
+	/**
+	 * The height of the current mode, in OS Units.
+	 */
+
+	int mode_height;
+
+	/**
+	 * The height of the iconbar, in OS Units.
+	 */
+
+	int iconbar_height;
+
+	/**
+	 * The number of OS units per pixel horizontally in the current mode.
+	 */
+
+	int x_units_per_pixel;
+
+	/**
+	 * The number of OS units per pixel vertically in the current mode.
+	 */
+
+	int y_units_per_pixel;
+
+	/**
+	 * The width of the panel sidebar on vertical panels.
+	 */
+
+	int sidebar_width;
+
+	/**
+	 * The height of the panel sidebar on horizontal panels.
+	 */
+
+	int sidebar_height;
+};
+
+/**
+ * The mapping between grid offsets and work area coordinates for a panel.
+ * A point which is a given distance along the grid's columns and rows is
+ * found at origin + (columns * column) + (rows * row).
+ */
+
+struct layout_transform {
+	/**
+	 * The work area coordinates of the grid origin.
+	 */
+
+	struct layout_coord origin;
+
+	/**
+	 * The work area unit vector in the direction of increasing column.
+	 */
+
+	struct layout_coord column;
+
+	/**
+	 * The work area unit vector in the direction of increasing row.
+	 */
+
+	struct layout_coord row;
+};
+
+/**
+ * The layout details of a single panel.
+ */
+
+struct layout_panel {
+	/**
+	 * The location of the panel.
+	 */
+
+	enum layout_position location;
+
+	/**
+	 * The sort position of the panel.
+	 */
+
+	int sort;
+
+	/**
+	 * The longitude weight of the panel.
+	 */
+
+	int longitude_weight;
+
+	/**
+	 * The number of columns in the visible grid.
+	 */
+
+	int grid_depth;
+
+	/**
+	 * The number of rows in the visible grid.
+	 */
+
+	struct layout_coord grid_dimensions;
+
+	/**
+	 * The origin of the button grid (in OS units).
+	 */
+
+	struct layout_coord origin;
+
+	/**
+	 * The lower (bottom) coordinate of the buttons window.
+	 */
+
+	int min_longitude;
+
+	/**
+	 * The upper (top) coordinate of the buttons window.
+	 */
+
+	int max_longitude;
+
+	/**
+	 * The size of a grid square (in OS units).
+	 */
+
+	int grid_square;
+
+	/**
+	 * The spacing between grid squares (in OS units).
+	 */
+
+	int grid_spacing;
+
+	/**
+	 * The dimensions of one button slab (in grid squares).
+	 */
+
+	struct layout_coord slab_grid_dimensions;
+
+	/**
+	 * The dimensions of one button slab (in OS units).
+	 */
+
+	struct layout_coord slab_os_dimensions;
+
+	/**
+	 * The work area extent of the panel window.
+	 */
+
+	struct layout_box extent;
+
+	/**
+	 * The extent of the sidebar icon within the work area.
+	 */
+
+	struct layout_box sidebar;
+
+	/**
+	 * The mapping between the grid and the work area.
+	 */
+
+	struct layout_transform transform;
+
+	/**
+	 * True if buttons which don't fit on the panel extend it along
+	 * its long axis, so that it must be scrolled; false if they
+	 * extend it outwards from the edge of the screen.
+	 */
+
+	bool scrolling;
+
+	/**
+	 * The scroll offset of a scrolling panel along its long axis, in
+	 * OS units from the start of the work area.
+	 */
+
+	int scroll;
+};
+
+
+/**
+ * Initialise a panel layout block with default values.
+ *
+ * \param *panel	The panel layout to initialise.
+ */
+
+void layout_initialise_panel(struct layout_panel *panel);
+
+
+/**
+ * Share the available space along each edge of the screen between the
+ * panels located there, updating their minimum and maximum longitudes.
+ *
+ * \param *panels[]	An array of pointers to the panels to arrange; this
+ *			will be sorted into panel order on exit.
+ * \param count		The number of panels in the array.
+ * \param *screen	The details of the screen.
+ */
+
+void layout_arrange_panels(struct layout_panel *panels[], size_t count, struct layout_screen *screen);
+
+
+/**
+ * Update the grid details for a panel from the user's choices.
+ *
+ * \param *panel	The panel layout to update.
+ * \param grid_square	The size of a grid square, in OS units.
+ * \param grid_spacing	The spacing between grid squares, in OS units.
+ * \param depth		The configured depth of the panel, in grid squares.
+ * \param *slab_size	The size of a button slab, in grid squares.
+ */
+
+void layout_set_grid(struct layout_panel *panel, int grid_square, int grid_spacing, int depth, struct layout_coord *slab_size);
+
+
+/**
+ * Reflow the buttons in a panel, to reflect the available space on the
+ * grid, updating the grid dimensions to include any overflow.
+ *
+ * \param *panel	The panel layout to use.
+ * \param buttons[]	The buttons to reflow, in position order.
+ * \param count		The number of buttons in the array.
+ */
+
+void layout_reflow_buttons(struct layout_panel *panel, struct layout_button buttons[], size_t count);
+
+
+/**
+ * Calculate the window extent, grid origin and sidebar extent for a panel.
+ *
+ * \param *panel	The panel layout to update.
+ * \param *screen	The details of the screen.
+ */
+
+void layout_set_extent(struct layout_panel *panel, struct layout_screen *screen);
+
+
+/**
+ * Calculate the visible area and scroll offsets of a panel window, either
+ * open to show its buttons or closed down to just its sidebar.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *screen	The details of the screen.
+ * \param open		true to calculate the open state; false for closed.
+ * \param *visible	Pointer to a box to take the visible area.
+ * \param *scroll	Pointer to a coordinate to take the scroll offsets.
+ */
+
+void layout_get_open_box(struct layout_panel *panel, struct layout_screen *screen, bool open, struct layout_box *visible, struct layout_coord *scroll);
+
+
+/**
+ * Calculate the extent of a button's icon within the panel work area.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *position	The button's grid position.
+ * \param *extent	Pointer to a box to take the icon extent.
+ */
+
+void layout_get_button_extent(struct layout_panel *panel, struct layout_coord *position, struct layout_box *extent);
+
+
+/**
+ * Find the grid cell containing a point in the panel work area.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *point	The work area coordinates of the point.
+ * \param *cell		Pointer to a coordinate to take the grid cell.
+ */
+
+void layout_get_grid_cell(struct layout_panel *panel, struct layout_coord *point, struct layout_coord *cell);
+
+
+/**
+ * Calculate the range of grid rows, along the long axis of a panel, whose
+ * buttons might intersect an area of the panel work area. The range is
+ * conservative, and the buttons returned must still be tested against the
+ * area itself.
+ *
+ * \param *panel	The panel layout to use.
+ * \param *area		The area of the work area to test.
+ * \param *first	Pointer to a variable to take the first row.
+ * \param *last		Pointer to a variable to take the last row.
+ * \return		true if any rows might intersect; else false.
+ */
+
+bool layout_get_row_range(struct layout_panel *panel, struct layout_box *area, int *first, int *last);
+
+
+/**
+ * Set the scroll offset of a panel along its long axis, limiting it to
+ * the available work area.
+ *
+ * \param *panel	The panel layout to update.
+ * \param scroll	The required scroll offset, in OS units.
+ * \return		true if the scroll offset changed; else false.
+ */
+
+bool layout_set_scroll(struct layout_panel *panel, int scroll);
+
+
+/**
+ * Calculate the range of grid rows which are visible in a panel at its
+ * current scroll offset, extended by a margin at each end.
+ *
+ * \param *panel	The panel layout to use.
+ * \param margin	The number of extra rows to include at each end.
+ * \param *first	Pointer to a variable to take the first row.
+ * \param *last		Pointer to a variable to take the last row.
+ * \return		true if any rows are visible; else false.
+ */
+
+bool layout_get_visible_rows(struct layout_panel *panel, int margin, int *first, int *last);
+
+
+/**
+ * Test whether any of the inputs which determine a panel's geometry have
+ * changed between two layouts. The edge, weight and sort order of the panel
+ * are tested through the longitudes which they produce.
+ *
+ * \param *panel	The new panel layout.
+ * \param *previous	The previous panel layout.
+ * \return		true if the geometry inputs differ; else false.
+ */
+
+bool layout_panel_changed(struct layout_panel *panel, struct layout_panel *previous);
+
+
+/**
+ * Test whether any of the screen details have changed between two screen
+ * descriptions.
+ *
+ * \param *screen	The new screen details.
+ * \param *previous	The previous screen details.
+ * \return		true if the details differ; else false.
+ */
+
+bool layout_screen_changed(struct layout_screen *screen, struct layout_screen *previous);
+
+#endif
+
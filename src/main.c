@@ -60,8 +60,12 @@
 #include "panel.h"
 #include "choices.h"
 #include "filing.h"
+#include "latency.h"
+#include "launch.h"
+#include "objutil.h"
 #include "paneldb.h"
 #include "proginfo.h"
+#include "reach.h"
 
 /**
  * The size of buffer allocated to resource filename processing.
@@ -109,8 +113,15 @@ int main(void)
 
 	main_poll_loop();
 
+	if (appdb_usage_unsafe())
+		filing_save_usage();
+
 	msgs_terminate();
 	panel_terminate();
+	launch_terminate();
+	objutil_terminate_sprites();
+	latency_terminate();
+	reach_terminate();
 	appdb_terminate();
 	paneldb_terminate();
 
@@ -129,14 +140,45 @@ static void main_poll_loop(void)
 	wimp_poll_flags	flags;
 	wimp_event_no	reason;
 	wimp_block	blk;
-	os_t		next_poll;
+	os_t		next_poll, poll_time, idle_time, launch_time, reach_time;
+	osbool		idle;
 
 	next_poll = os_read_monotonic_time();
 
 	while (!main_quit_flag) {
-		flags = (next_poll != 0) ? 0 : wimp_MASK_NULL;
+		/* If the panels, the launch queue or the disc probes have
+		 * work waiting, such as deferred layout changes, background
+		 * checks or launches, ask for a null event when it is due,
+		 * unless SFLib needs one sooner.
+		 */
+
+		idle = panel_get_idle_time(&idle_time);
+
+		if (launch_get_idle_time(&launch_time) && (!idle || (int) (launch_time - idle_time) < 0)) {
+			idle = TRUE;
+			idle_time = launch_time;
+		}
+
+		if (reach_get_idle_time(&reach_time) && (!idle || (int) (reach_time - idle_time) < 0)) {
+			idle = TRUE;
+			idle_time = reach_time;
+		}
+
+		if (idle && (next_poll == 0 || (int) (idle_time - next_poll) < 0)) {
+			flags = 0;
+			poll_time = idle_time;
+		} else {
+			flags = (next_poll != 0) ? 0 : wimp_MASK_NULL;
+			poll_time = next_poll;
+		}
 
-		reason = wimp_poll_idle(flags, &blk, next_poll, NULL);
+		reason = wimp_poll_idle(flags, &blk, poll_time, NULL);
+
+		if (reason == wimp_NULL_REASON_CODE) {
+			reach_process_idle();
+			panel_process_idle();
+			launch_process_idle();
+		}
 
 		if (!event_process_event(reason, &blk, 0, &next_poll)) {
 			switch (reason) {
@@ -215,6 +257,14 @@ static void main_initialise(void)
 	config_opt_init("ConfirmDelete", TRUE);					/**< TRUE to confirm button deletion; FALSE to delete immediately.	*/
 	config_opt_init("MouseOver", FALSE);					/**< TRUE to open panels when the mouse passes over them.		*/
 	config_int_init("OpenDelay", 50);					/**< The delay before auto-opening, in centiseconds.			*/
+	config_opt_init("BackingStore", FALSE);					/**< TRUE to redraw panels from an off-screen sprite.			*/
+	config_int_init("BackingStoreLimit", 256);				/**< The maximum size of a panel's off-screen sprite, in Kbytes.	*/
+	config_opt_init("ScrollPanels", FALSE);					/**< TRUE to scroll panels whose buttons don't fit; FALSE to widen them.	*/
+	config_opt_init("IconlessPanels", FALSE);				/**< TRUE to hit-test panel buttons without creating Wimp icons.	*/
+	config_int_init("PrefetchDelay", 25);					/**< The time the pointer must rest on a button before prefetching.	*/
+	config_opt_init("AutoArrange", FALSE);					/**< TRUE to arrange the buttons in each panel by how often they are used.	*/
+	config_int_init("ValidateBudget", 2);					/**< The longest time spent checking button targets on each null poll.	*/
+	config_opt_init("SwitchToRunning", FALSE);				/**< TRUE to bring a button's running task to the front instead of relaunching.	*/
 
 	config_load();
 
@@ -239,6 +289,7 @@ static void main_initialise(void)
 	proginfo_initialise();
 	paneldb_initialise();
 	appdb_initialise();
+	launch_initialise();
 	panel_initialise();
 	choices_initialise();
 
@@ -27,6 +27,7 @@
 
 /* ANSI C header files. */
 
+#include <ctype.h>
 #include <string.h>
 #include <stdio.h>
 
@@ -35,6 +36,7 @@
 #include "oslib/fileswitch.h"
 #include "oslib/os.h"
 #include "oslib/osfile.h"
+#include "oslib/wimp.h"
 #include "oslib/wimpspriteop.h"
 
 /* SF-Lib header files. */
@@ -47,12 +49,146 @@
 
 #include "objutil.h"
 
+#include "reach.h"
+
 /**
  * Space allocated for FS commands.
  */
 
 #define OBJUTIL_COMMAND_LEN 30
 
+/**
+ * The size of the buffer on the stack used for most FS commands.
+ */
+
+#define OBJUTIL_COMMAND_BUFFER_LEN 256
+
+/**
+ * Space allocated for the leafname of an application's !Run file.
+ */
+
+#define OBJUTIL_RUN_FILE_LEN 6
+
+/**
+ * The maximum length of a sprite name, including terminator.
+ */
+
+#define OBJUTIL_SPRITE_NAME_LEN 13
+
+/**
+ * The number of hash buckets in the sprite cache.
+ */
+
+#define OBJUTIL_SPRITE_BUCKETS 32
+
+/**
+ * The number of entries in the filetype sprite cache.
+ */
+
+#define OBJUTIL_TYPE_BUCKETS 32
+
+/**
+ * An entry in the sprite resolution cache.
+ */
+
+struct objutil_sprite {
+	/**
+	 * The name of the sprite.
+	 */
+
+	char name[OBJUTIL_SPRITE_NAME_LEN];
+
+	/**
+	 * TRUE if the sprite was in the Wimp Sprite Pool when last tested.
+	 */
+
+	osbool exists;
+
+	/**
+	 * The sprite to use if this one isn't in the pool, or NULL.
+	 */
+
+	char *fallback;
+
+	/**
+	 * The cache generation at which the entry was last tested.
+	 */
+
+	unsigned generation;
+
+	/**
+	 * The batch in which the entry was last tested.
+	 */
+
+	unsigned batch;
+
+	/**
+	 * Pointer to the next entry in the hash bucket.
+	 */
+
+	struct objutil_sprite *next;
+};
+
+/**
+ * An entry in the filetype sprite cache, holding the sprite to use for
+ * files of a given type.
+ */
+
+struct objutil_type_sprite {
+	/**
+	 * The filetype which the entry is for.
+	 */
+
+	bits file_type;
+
+	/**
+	 * The sprite to use for the filetype, or NULL if the entry is empty.
+	 */
+
+	char *sprite;
+
+	/**
+	 * The batch in which the sprite was looked up.
+	 */
+
+	unsigned batch;
+};
+
+/**
+ * The sprite resolution cache hash table.
+ */
+
+static struct objutil_sprite *objutil_sprite_cache[OBJUTIL_SPRITE_BUCKETS];
+
+/**
+ * The current sprite cache generation; entries from older generations
+ * must be tested again before use.
+ */
+
+static unsigned objutil_sprite_generation = 1;
+
+/**
+ * The filetype sprite cache, which is only valid within a single batch.
+ */
+
+static struct objutil_type_sprite objutil_type_cache[OBJUTIL_TYPE_BUCKETS];
+
+/**
+ * The current sprite lookup batch.
+ */
+
+static unsigned objutil_sprite_batch = 0;
+
+/* Static Function Prototypes. */
+
+static void objutil_find_request_sprite(struct objutil_sprite_request *request);
+static char *objutil_find_type_sprite(bits file_type);
+static char *objutil_resolve_batch_sprite(char *sprite, char *fallback);
+static struct objutil_sprite *objutil_lookup_sprite(char *sprite, char *fallback, osbool refresh);
+static osbool objutil_read_sprite(char *sprite);
+static osbool objutil_read_target(char *object, struct objutil_target *target, osbool report);
+static os_error *objutil_run_target(char *object, enum objutil_target_type type, char *buffer, size_t length, wimp_t *task);
+
 
 /**
  * Given an object referenced by a filename, find an appropriate sprite
@@ -67,49 +203,124 @@
 
 osbool objutil_find_sprite(char *object, char *sprite, size_t length, osbool *bootable)
 {
-	fileswitch_object_type	object_type;
-	bits			load_addr, file_type;
-	os_error		*error;
-	char			*leafname;
+	struct objutil_sprite_request request;
+
+	request.object = object;
+	request.sprite = sprite;
+	request.length = length;
+
+	objutil_find_sprites(&request, 1);
 
 	if (bootable != NULL)
-		*bootable = FALSE;
+		*bootable = request.bootable;
 
-	if (sprite == NULL || length == 0)
-		return FALSE;
+	switch (request.result) {
+	case OBJUTIL_SPRITE_FOUND:
+		return TRUE;
 
-	*sprite = '\0';
+	case OBJUTIL_SPRITE_MISSING:
+		error_msgs_report_error("ObjectMissing");
+		break;
 
-	if (object == NULL)
-		return FALSE;
+	case OBJUTIL_SPRITE_BAD_TYPE:
+		error_msgs_report_error("ObjectBadType");
+		break;
 
-	/* Identify what we're working with. */
+	case OBJUTIL_SPRITE_UNREACHABLE:
+		error_msgs_report_error("ObjectUnreachable");
+		break;
 
-	leafname = string_find_leafname(object);
+	case OBJUTIL_SPRITE_ERROR:
+		if (request.error != NULL)
+			error_report_os_error(request.error, wimp_ERROR_BOX_OK_ICON);
+		break;
+	}
 
-	error = xosfile_read_stamped_no_path(object, &object_type, NULL, NULL, NULL, NULL, &file_type);
-	if (error != NULL) {
-		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
-		return FALSE;
+	return FALSE;
+}
+
+
+/**
+ * Given a list of objects referenced by filenames, find an appropriate
+ * sprite for each from the Wimp Sprite Pool. Each object's type is read
+ * with a single filing system call where possible, and each sprite is
+ * only looked up once per batch. No errors are reported: the outcome for
+ * each object is returned in its request.
+ *
+ * \param *requests	The list of requests to process.
+ * \param count		The number of requests in the list.
+ */
+
+void objutil_find_sprites(struct objutil_sprite_request *requests, int count)
+{
+	int i;
+
+	if (requests == NULL)
+		return;
+
+	/* Start a new batch, so that each sprite is tested against the
+	 * pool again the first time that the batch uses it.
+	 */
+
+	objutil_sprite_batch++;
+
+	for (i = 0; i < count; i++)
+		objutil_find_request_sprite(requests + i);
+}
+
+
+/**
+ * Find a sprite for a single object as part of a batch.
+ *
+ * \param *request	The request to process.
+ */
+
+static void objutil_find_request_sprite(struct objutil_sprite_request *request)
+{
+	fileswitch_object_type	object_type;
+	bits			load_addr, file_type;
+	char			*name;
+
+	request->bootable = FALSE;
+	request->result = OBJUTIL_SPRITE_ERROR;
+	request->error = NULL;
+
+	if (request->sprite == NULL || request->length == 0)
+		return;
+
+	*(request->sprite) = '\0';
+
+	if (request->object == NULL)
+		return;
+
+	/* Don't wait for a disc which isn't responding. */
+
+	if (reach_get_state(request->object) == REACH_STATE_UNREACHABLE) {
+		request->result = OBJUTIL_SPRITE_UNREACHABLE;
+		return;
 	}
 
+	/* Identify what we're working with. */
+
+	request->error = xosfile_read_stamped_no_path(request->object, &object_type, NULL, NULL, NULL, NULL, &file_type);
+	if (request->error != NULL)
+		return;
+
 	if (object_type == fileswitch_NOT_FOUND) {
-		error_msgs_report_error("ObjectMissing");
-		return FALSE;
+		request->result = OBJUTIL_SPRITE_MISSING;
+		return;
 	}
 
 	/* If this is an image file the filetype will be unhelpful, so read it manually. */
 
 	if (object_type == fileswitch_IS_IMAGE) {
-		error = xosfile_read_no_path(object, &object_type, &load_addr, NULL, NULL, NULL);
-		if (error != NULL) {
-			error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
-			return FALSE;
-		}
+		request->error = xosfile_read_no_path(request->object, &object_type, &load_addr, NULL, NULL, NULL);
+		if (request->error != NULL)
+			return;
 
 		if (object_type != fileswitch_IS_IMAGE) {
-			error_msgs_report_error("ObjectBadType");
-			return FALSE;
+			request->result = OBJUTIL_SPRITE_BAD_TYPE;
+			return;
 		}
 
 		file_type = (load_addr & osfile_FILE_TYPE) >> osfile_FILE_TYPE_SHIFT;
@@ -118,38 +329,87 @@ osbool objutil_find_sprite(char *object, char *sprite, size_t length, osbool *bo
 	switch (object_type) {
 	case fileswitch_IS_FILE:
 	case fileswitch_IS_IMAGE:
-		if (file_type == osfile_TYPE_UNTYPED) {
-			string_copy(sprite, "file_lxa", length);
-		} else {
-			string_printf(sprite, length, "file_%3x", file_type);
-			if (!objutil_test_sprite(sprite))
-				string_copy(sprite, "file_xxx", length);
-		}
+		string_copy(request->sprite, objutil_find_type_sprite(file_type), request->length);
 		break;
 
 	case fileswitch_IS_DIR:
 		switch (file_type) {
 		case osfile_TYPE_DIR:
-			string_copy(sprite, "directory", length);
+			string_copy(request->sprite, "directory", request->length);
 			break;
 
 		case osfile_TYPE_APPLICATION:
-			string_copy(sprite, leafname, length);
-			string_tolower(sprite);
-			if (!objutil_test_sprite(sprite))
-				string_copy(sprite, "application", length);
-			if (bootable != NULL)
-				*bootable = TRUE;
+			string_copy(request->sprite, string_find_leafname(request->object), request->length);
+			string_tolower(request->sprite);
+			name = objutil_resolve_batch_sprite(request->sprite, "application");
+			string_copy(request->sprite, name, request->length);
+			request->bootable = TRUE;
 			break;
 		}
 		break;
 	}
 
-	return TRUE;
+	request->result = OBJUTIL_SPRITE_FOUND;
+}
+
+
+/**
+ * Find the sprite to use for a file of a given type, using the filetype
+ * cache if the type has already been seen in the current batch.
+ *
+ * \param file_type	The filetype to find the sprite for.
+ * \return		Pointer to the name of the sprite to use.
+ */
+
+static char *objutil_find_type_sprite(bits file_type)
+{
+	char				name[OBJUTIL_SPRITE_NAME_LEN];
+	struct objutil_type_sprite	*entry;
+
+	if (file_type == osfile_TYPE_UNTYPED)
+		return "file_lxa";
+
+	entry = objutil_type_cache + (file_type % OBJUTIL_TYPE_BUCKETS);
+
+	if (entry->batch == objutil_sprite_batch && entry->file_type == file_type && entry->sprite != NULL)
+		return entry->sprite;
+
+	string_printf(name, OBJUTIL_SPRITE_NAME_LEN, "file_%3x", file_type);
+
+	entry->file_type = file_type;
+	entry->sprite = objutil_resolve_batch_sprite(name, "file_xxx");
+	entry->batch = objutil_sprite_batch;
+
+	return entry->sprite;
+}
+
+
+/**
+ * Resolve a sprite name into one which can be plotted from the Wimp Sprite
+ * Pool, testing the sprite again if it hasn't already been tested in the
+ * current batch.
+ *
+ * \param *sprite	The name of the sprite to resolve.
+ * \param *fallback	The sprite to use if the named sprite is not in
+ *			the pool.
+ * \return		Pointer to the name of the sprite to use, which
+ *			will remain valid for the life of the application.
+ */
+
+static char *objutil_resolve_batch_sprite(char *sprite, char *fallback)
+{
+	struct objutil_sprite *entry;
+
+	entry = objutil_lookup_sprite(sprite, fallback, TRUE);
+	if (entry == NULL || !entry->exists)
+		return fallback;
+
+	return entry->name;
 }
 
 /**
- * Test a sprite to see if it is in the Wimp Sprite Pool.
+ * Test a sprite to see if it is in the Wimp Sprite Pool, using the sprite
+ * cache if the sprite has been tested before.
  *
  * \param *sprite	The name of the sprite to test.
  * \return		TRUE if the sprite exists; else FALSE.
@@ -157,12 +417,353 @@ osbool objutil_find_sprite(char *object, char *sprite, size_t length, osbool *bo
 
 osbool objutil_test_sprite(char *sprite)
 {
+	struct objutil_sprite *entry;
+
 	if (sprite == NULL)
 		return FALSE;
 
+	entry = objutil_lookup_sprite(sprite, NULL, FALSE);
+	if (entry == NULL)
+		return objutil_read_sprite(sprite);
+
+	return entry->exists;
+}
+
+
+/**
+ * Resolve a sprite name into one which can be plotted from the Wimp Sprite
+ * Pool, using the sprite cache so that no SpriteOps are required if the
+ * sprite has been seen before.
+ *
+ * The returned pointer will remain valid for the life of the application,
+ * and will not be affected by changes to the flex heap.
+ *
+ * \param *sprite	The name of the sprite to resolve.
+ * \param *fallback	The sprite to use if the named sprite is not in
+ *			the pool.
+ * \return		Pointer to the name of the sprite to plot.
+ */
+
+char *objutil_resolve_sprite(char *sprite, char *fallback)
+{
+	struct objutil_sprite *entry;
+
+	if (sprite == NULL)
+		return fallback;
+
+	entry = objutil_lookup_sprite(sprite, fallback, FALSE);
+	if (entry == NULL)
+		return fallback;
+
+	return (entry->exists) ? entry->name : entry->fallback;
+}
+
+
+/**
+ * Invalidate the sprite cache, so that all sprites are tested again when
+ * next used. This should be called when the contents of the Wimp Sprite
+ * Pool might have changed.
+ */
+
+void objutil_invalidate_sprites(void)
+{
+	objutil_sprite_generation++;
+}
+
+
+/**
+ * Return the current sprite cache generation, so that clients holding
+ * resolved sprite names can tell when they need to resolve them again.
+ *
+ * \return		The current sprite cache generation.
+ */
+
+unsigned objutil_get_sprite_generation(void)
+{
+	return objutil_sprite_generation;
+}
+
+
+/**
+ * Terminate the sprite cache, freeing its memory.
+ */
+
+void objutil_terminate_sprites(void)
+{
+	struct objutil_sprite	*entry;
+	int			i;
+
+	/* The filetype cache points into the sprite cache entries. */
+
+	for (i = 0; i < OBJUTIL_TYPE_BUCKETS; i++)
+		objutil_type_cache[i].sprite = NULL;
+
+	for (i = 0; i < OBJUTIL_SPRITE_BUCKETS; i++) {
+		while (objutil_sprite_cache[i] != NULL) {
+			entry = objutil_sprite_cache[i];
+			objutil_sprite_cache[i] = entry->next;
+
+			heap_free(entry);
+		}
+	}
+}
+
+
+/**
+ * Find a sprite in the sprite cache, adding it if it isn't present and
+ * testing it against the Wimp Sprite Pool if the entry is out of date.
+ *
+ * \param *sprite	The name of the sprite to find.
+ * \param *fallback	The fallback sprite to record, or NULL to leave
+ *			any existing fallback unchanged.
+ * \param refresh	TRUE to test the sprite again if it hasn't been
+ *			tested in the current batch, even if the cached
+ *			entry is current.
+ * \return		Pointer to the cache entry, or NULL on failure.
+ */
+
+static struct objutil_sprite *objutil_lookup_sprite(char *sprite, char *fallback, osbool refresh)
+{
+	char			name[OBJUTIL_SPRITE_NAME_LEN];
+	unsigned		hash = 0;
+	int			i;
+	struct objutil_sprite	*entry;
+
+	if (sprite == NULL)
+		return NULL;
+
+	/* Take a lower case copy of the name, since sprite names are
+	 * case insensitive and the original may be in the flex heap.
+	 */
+
+	for (i = 0; i < OBJUTIL_SPRITE_NAME_LEN && sprite[i] != '\0'; i++) {
+		name[i] = tolower(sprite[i]);
+		hash = (hash * 31) + name[i];
+	}
+
+	if (i >= OBJUTIL_SPRITE_NAME_LEN)
+		return NULL;
+
+	name[i] = '\0';
+	hash %= OBJUTIL_SPRITE_BUCKETS;
+
+	/* Find an existing entry, or create a new one. */
+
+	entry = objutil_sprite_cache[hash];
+
+	while (entry != NULL && strcmp(entry->name, name) != 0)
+		entry = entry->next;
+
+	if (entry == NULL) {
+		entry = heap_alloc(sizeof(struct objutil_sprite));
+		if (entry == NULL)
+			return NULL;
+
+		string_copy(entry->name, name, OBJUTIL_SPRITE_NAME_LEN);
+		entry->fallback = NULL;
+		entry->generation = 0;
+		entry->batch = 0;
+
+		entry->next = objutil_sprite_cache[hash];
+		objutil_sprite_cache[hash] = entry;
+	}
+
+	if (fallback != NULL)
+		entry->fallback = fallback;
+
+	/* Test the sprite if the entry is out of date. */
+
+	if ((refresh && entry->batch != objutil_sprite_batch) || entry->generation != objutil_sprite_generation) {
+		entry->exists = objutil_read_sprite(entry->name);
+		entry->generation = objutil_sprite_generation;
+		entry->batch = objutil_sprite_batch;
+	}
+
+	return entry;
+}
+
+
+/**
+ * Test a sprite to see if it is in the Wimp Sprite Pool, bypassing the
+ * sprite cache.
+ *
+ * \param *sprite	The name of the sprite to test.
+ * \return		TRUE if the sprite exists; else FALSE.
+ */
+
+static osbool objutil_read_sprite(char *sprite)
+{
 	return xwimpspriteop_read_sprite_info(sprite, NULL, NULL, NULL, NULL) == NULL;
 }
 
+/**
+ * Clear a launch target's cached details, so that the object will be
+ * examined again before it is next launched.
+ *
+ * \param *target	The launch target to clear.
+ */
+
+void objutil_clear_target(struct objutil_target *target)
+{
+	if (target == NULL)
+		return;
+
+	target->type = OBJUTIL_TARGET_UNKNOWN;
+	target->file_type = 0;
+	target->load_addr = 0;
+	target->exec_addr = 0;
+	target->checked = 0;
+}
+
+
+/**
+ * Examine an object referenced by a filename, and update a launch target's
+ * cached details to reflect what was found. No errors are reported, so this
+ * is suitable for revalidating targets in the background.
+ *
+ * \param *object	The filename of the object to examine.
+ * \param *target	The launch target to update.
+ * \return		TRUE if the type or date stamp of the target
+ *			changed; else FALSE.
+ */
+
+osbool objutil_refresh_target(char *object, struct objutil_target *target)
+{
+	struct objutil_target previous;
+
+	if (object == NULL || target == NULL)
+		return FALSE;
+
+	previous = *target;
+
+	objutil_read_target(object, target, FALSE);
+
+	return (target->type != previous.type || target->load_addr != previous.load_addr ||
+			target->exec_addr != previous.exec_addr) ? TRUE : FALSE;
+}
+
+
+/**
+ * Examine an object ahead of it being launched, updating a launch target's
+ * cached details and bringing the parts of the object which the launch will
+ * need into the filing system's cache. No errors are reported.
+ *
+ * \param *object	The filename of the object to examine.
+ * \param *target	The launch target to update.
+ * \return		TRUE if the object can be launched; else FALSE.
+ */
+
+osbool objutil_prefetch_target(char *object, struct objutil_target *target)
+{
+	char			filename[OBJUTIL_COMMAND_BUFFER_LEN];
+	fileswitch_object_type	object_type;
+
+	if (object == NULL || target == NULL)
+		return FALSE;
+
+	if (reach_get_state(object) == REACH_STATE_UNREACHABLE || !objutil_read_target(object, target, FALSE))
+		return FALSE;
+
+	/* Starting an application will run its !Run file, so look that up
+	 * too; the result doesn't matter, as long as the filing system has
+	 * been to fetch the directory.
+	 */
+
+	if (target->type == OBJUTIL_TARGET_APPLICATION && strlen(object) + OBJUTIL_RUN_FILE_LEN < OBJUTIL_COMMAND_BUFFER_LEN) {
+		string_printf(filename, OBJUTIL_COMMAND_BUFFER_LEN, "%s.!Run", object);
+		xosfile_read_stamped_no_path(filename, &object_type, NULL, NULL, NULL, NULL, NULL);
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Launch an object referenced by a supplied filename, using the type held
+ * in a launch target's cache if it is known. The object will only be
+ * examined if its type is unknown, or if the launch fails. The launch is
+ * carried out as a new task, via Wimp_StartTask. Files are run via the
+ * Filer, so no task handle is ever returned for them.
+ *
+ * \param *object	The filename of the object to launch.
+ * \param *target	The launch target holding the object's details.
+ * \param *task		Pointer to a variable to take the handle of the
+ *			new task if it is still running, or NULL.
+ * \return		TRUE if successful; FALSE on error.
+ */
+
+osbool objutil_launch_target(char *object, struct objutil_target *target, wimp_t *task)
+{
+	char				command[OBJUTIL_COMMAND_BUFFER_LEN], *buffer;
+	size_t				length;
+	enum objutil_target_type	previous;
+	os_error			*error;
+
+	if (object == NULL || target == NULL)
+		return FALSE;
+
+	/* If the object's disc didn't respond when last probed, don't wait
+	 * for its filing system to time out again.
+	 */
+
+	if (reach_get_state(object) == REACH_STATE_UNREACHABLE) {
+		error_msgs_report_error("ObjectUnreachable");
+		return FALSE;
+	}
+
+	/* If the object hasn't been seen, or was unusable when it was last
+	 * examined, look at it again now so that the user gets a sensible
+	 * error if it still can't be launched.
+	 */
+
+	if ((target->type == OBJUTIL_TARGET_UNKNOWN || target->type == OBJUTIL_TARGET_INVALID) &&
+			!objutil_read_target(object, target, TRUE))
+		return FALSE;
+
+	/* Most commands will fit into the buffer on the stack; if this one
+	 * doesn't, allocate a buffer for it.
+	 */
+
+	length = strlen(object) + OBJUTIL_COMMAND_LEN;
+
+	if (length > OBJUTIL_COMMAND_BUFFER_LEN) {
+		buffer = heap_alloc(length);
+
+		if (buffer == NULL) {
+			error_msgs_report_error("NoMemLaunch");
+			return FALSE;
+		}
+	} else {
+		buffer = command;
+		length = OBJUTIL_COMMAND_BUFFER_LEN;
+	}
+
+	/* Launch the object using the cached type. If this fails, the object
+	 * may have changed since it was last examined: look again, and retry
+	 * if it now appears to be something different.
+	 */
+
+	error = objutil_run_target(object, target->type, buffer, length, task);
+
+	if (error != NULL) {
+		previous = target->type;
+
+		if (!objutil_read_target(object, target, TRUE))
+			error = NULL;
+		else if (target->type != previous)
+			error = objutil_run_target(object, target->type, buffer, length, task);
+
+		if (error != NULL)
+			error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
+	}
+
+	if (buffer != command)
+		heap_free(buffer);
+
+	return (error == NULL && target->type != OBJUTIL_TARGET_INVALID && target->type != OBJUTIL_TARGET_UNKNOWN) ? TRUE : FALSE;
+}
+
+
 /**
  * Launch an object referenced by a supplied filename.
  * 
@@ -172,79 +773,142 @@ osbool objutil_test_sprite(char *sprite)
 
 osbool objutil_launch(char *object)
 {
-	char			*buffer;
-	int			length;
+	struct objutil_target target;
+
+	objutil_clear_target(&target);
+
+	return objutil_launch_target(object, &target, NULL);
+}
+
+
+/**
+ * Examine an object referenced by a filename, and update a launch target's
+ * cached details to reflect what was found.
+ *
+ * \param *object	The filename of the object to examine.
+ * \param *target	The launch target to update.
+ * \param report	TRUE to report any problems to the user; else FALSE.
+ * \return		TRUE if the object can be launched; else FALSE.
+ */
+
+static osbool objutil_read_target(char *object, struct objutil_target *target, osbool report)
+{
 	fileswitch_object_type	object_type;
-	bits			file_type;
+	bits			load_addr, exec_addr, file_type;
 	os_error		*error;
-	osbool			command_ready = FALSE;
 
-	if (object == NULL)
-		return FALSE;
+	error = xosfile_read_stamped_no_path(object, &object_type, &load_addr, &exec_addr, NULL, NULL, &file_type);
 
-	/* Identify what we're working with. */
+	target->checked = os_read_monotonic_time();
+
+	/* If the object couldn't be read, its filing system may be
+	 * unavailable: we don't know anything about it, and its disc
+	 * should be probed again.
+	 */
 
-	error = xosfile_read_stamped_no_path(object, &object_type, NULL, NULL, NULL, NULL, &file_type);
 	if (error != NULL) {
-		error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
-		return FALSE;
-	}
+		target->type = OBJUTIL_TARGET_UNKNOWN;
 
-	if (object_type == fileswitch_NOT_FOUND) {
-		error_msgs_report_error("ObjectMissing");
-		return FALSE;
-	}
+		reach_request_probe(object);
 
-	/* Allocate a buffer for the command. */
+		if (report)
+			error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
 
-	length = strlen(object) + OBJUTIL_COMMAND_LEN;
+		return FALSE;
+	}
 
-	buffer = heap_alloc(length);
+	/* The date stamp of a missing object is meaningless, so don't let it
+	 * look like a change next time around.
+	 */
 
-	if (buffer == NULL) {
-		error_msgs_report_error("NoMemLaunch");
-		return FALSE;
+	if (object_type == fileswitch_NOT_FOUND) {
+		load_addr = 0;
+		exec_addr = 0;
 	}
 
-	/* Create a command. */
+	target->file_type = file_type;
+	target->load_addr = load_addr;
+	target->exec_addr = exec_addr;
 
 	switch (object_type) {
 	case fileswitch_IS_FILE:
 	case fileswitch_IS_IMAGE:
-		string_printf(buffer, length, "%%Filer_Run %s", object);
-		command_ready = TRUE;
+		target->type = OBJUTIL_TARGET_FILE;
 		break;
 
 	case fileswitch_IS_DIR:
-		switch (file_type) {
-		case osfile_TYPE_DIR:
-			string_printf(buffer, length, "%%Filer_OpenDir %s", object);
-			command_ready = TRUE;
-			break;
+		if (file_type == osfile_TYPE_DIR)
+			target->type = OBJUTIL_TARGET_DIRECTORY;
+		else if (file_type == osfile_TYPE_APPLICATION)
+			target->type = OBJUTIL_TARGET_APPLICATION;
+		else
+			target->type = OBJUTIL_TARGET_INVALID;
+		break;
 
-		case osfile_TYPE_APPLICATION:
-			string_printf(buffer, length, "%%StartDesktopTask %s", object);
-			command_ready = TRUE;
-			break;
-		}
+	default:
+		target->type = OBJUTIL_TARGET_INVALID;
 		break;
 	}
 
-	/* Launch the command, if ready. */
+	if (target->type != OBJUTIL_TARGET_INVALID)
+		return TRUE;
 
-	if (command_ready == TRUE) {
-		error = xos_cli(buffer);
-		if (error != NULL) {
-			error_report_os_error(error, wimp_ERROR_BOX_OK_ICON);
-			command_ready = FALSE;
-		}
-	} else {
-		error_msgs_report_error("ObjectBadType");
+	if (report)
+		error_msgs_report_error((object_type == fileswitch_NOT_FOUND) ? "ObjectMissing" : "ObjectBadType");
+
+	return FALSE;
+}
+
+
+/**
+ * Build the command to launch an object of a given type, and start it as
+ * a new task.
+ *
+ * \param *object	The filename of the object to launch.
+ * \param type		The type of the object.
+ * \param *buffer	Pointer to a buffer to hold the command.
+ * \param length	The length of the supplied buffer.
+ * \param *task		Pointer to a variable to take the handle of the
+ *			new task if it is still running, or NULL.
+ * \return		Pointer to an error block, or NULL on success.
+ */
+
+static os_error *objutil_run_target(char *object, enum objutil_target_type type, char *buffer, size_t length, wimp_t *task)
+{
+	os_error	*error;
+	wimp_t		handle;
+
+	if (task != NULL)
+		*task = 0;
+
+	switch (type) {
+	case OBJUTIL_TARGET_FILE:
+		string_printf(buffer, length, "%%Filer_Run %s", object);
+		break;
+
+	case OBJUTIL_TARGET_DIRECTORY:
+		string_printf(buffer, length, "%%Filer_OpenDir %s", object);
+		break;
+
+	case OBJUTIL_TARGET_APPLICATION:
+		/* Run the application directly in the new task, so that the
+		 * handle returned is the application's own. Running it via
+		 * *StartDesktopTask would return the handle of a task which
+		 * just runs that command.
+		 */
+
+		string_printf(buffer, length, "/%s", object);
+		break;
+
+	case OBJUTIL_TARGET_UNKNOWN:
+	case OBJUTIL_TARGET_INVALID:
+		return NULL;
 	}
 
-	/* Free the buffer and return. */
+	error = xwimp_start_task(buffer, &handle);
 
-	heap_free(buffer);
+	if (error == NULL && task != NULL)
+		*task = handle;
 
-	return command_ready;
-}
\ No newline at end of file
+	return error;
+}
@@ -28,6 +28,113 @@
 #ifndef LAUNCHER_OBJUTIL
 #define LAUNCHER_OBJUTIL
 
+/**
+ * The types of object which can be launched.
+ */
+
+enum objutil_target_type {
+	OBJUTIL_TARGET_UNKNOWN = 0,	/**< The object has not been examined.			*/
+	OBJUTIL_TARGET_FILE,		/**< The object is a file or image, to be run.		*/
+	OBJUTIL_TARGET_DIRECTORY,	/**< The object is a directory, to be opened.		*/
+	OBJUTIL_TARGET_APPLICATION,	/**< The object is an application, to be started.	*/
+	OBJUTIL_TARGET_INVALID		/**< The object is missing, or can't be launched.	*/
+};
+
+/**
+ * The outcomes of finding a sprite for an object.
+ */
+
+enum objutil_sprite_result {
+	OBJUTIL_SPRITE_FOUND = 0,	/**< A sprite was found for the object.		*/
+	OBJUTIL_SPRITE_MISSING,		/**< The object was not found.				*/
+	OBJUTIL_SPRITE_BAD_TYPE,	/**< The type of the object couldn't be identified.	*/
+	OBJUTIL_SPRITE_UNREACHABLE,	/**< The disc holding the object isn't responding.	*/
+	OBJUTIL_SPRITE_ERROR		/**< The object couldn't be read.			*/
+};
+
+/**
+ * A request to find a sprite for an object, as part of a batch.
+ */
+
+struct objutil_sprite_request {
+	/**
+	 * The filename of the object to process.
+	 */
+
+	char				*object;
+
+	/**
+	 * Pointer to a buffer to hold the sprite name.
+	 */
+
+	char				*sprite;
+
+	/**
+	 * The length of the sprite name buffer.
+	 */
+
+	size_t				length;
+
+	/**
+	 * Set to TRUE if the object can be booted; else FALSE.
+	 */
+
+	osbool				bootable;
+
+	/**
+	 * The outcome of the request.
+	 */
+
+	enum objutil_sprite_result	result;
+
+	/**
+	 * The error returned on reading the object, if the outcome was
+	 * OBJUTIL_SPRITE_ERROR. This is only valid until the next call to
+	 * the OS, so can only be used for the last object in a batch.
+	 */
+
+	os_error			*error;
+};
+
+/**
+ * The cached details of a launch target, so that it can be launched without
+ * having to examine the object on disc first.
+ */
+
+struct objutil_target {
+	/**
+	 * The type of the object, when last examined.
+	 */
+
+	enum objutil_target_type	type;
+
+	/**
+	 * The filetype of the object, when last examined.
+	 */
+
+	bits				file_type;
+
+	/**
+	 * The load address of the object, holding its date stamp, when
+	 * last examined.
+	 */
+
+	bits				load_addr;
+
+	/**
+	 * The execution address of the object, holding its date stamp, when
+	 * last examined.
+	 */
+
+	bits				exec_addr;
+
+	/**
+	 * The monotonic time at which the object was last examined.
+	 */
+
+	os_t				checked;
+};
+
 
 /**
  * Given an object referenced by a filename, find an appropriate sprite
@@ -43,6 +150,20 @@
 osbool objutil_find_sprite(char *object, char *sprite, size_t length, osbool *bootable);
 
 
+/**
+ * Given a list of objects referenced by filenames, find an appropriate
+ * sprite for each from the Wimp Sprite Pool. Each object's type is read
+ * with a single filing system call where possible, and each sprite is
+ * only looked up once per batch. No errors are reported: the outcome for
+ * each object is returned in its request.
+ *
+ * \param *requests	The list of requests to process.
+ * \param count		The number of requests in the list.
+ */
+
+void objutil_find_sprites(struct objutil_sprite_request *requests, int count);
+
+
 /**
  * Test a sprite to see if it is in the Wimp Sprite Pool.
  *
@@ -53,6 +174,103 @@ osbool objutil_find_sprite(char *object, char *sprite, size_t length, osbool *bo
 osbool objutil_test_sprite(char *sprite);
 
 
+/**
+ * Resolve a sprite name into one which can be plotted from the Wimp Sprite
+ * Pool, using the sprite cache so that no SpriteOps are required if the
+ * sprite has been seen before.
+ *
+ * The returned pointer will remain valid for the life of the application,
+ * and will not be affected by changes to the flex heap.
+ *
+ * \param *sprite	The name of the sprite to resolve.
+ * \param *fallback	The sprite to use if the named sprite is not in
+ *			the pool.
+ * \return		Pointer to the name of the sprite to plot.
+ */
+
+char *objutil_resolve_sprite(char *sprite, char *fallback);
+
+
+/**
+ * Invalidate the sprite cache, so that all sprites are tested again when
+ * next used. This should be called when the contents of the Wimp Sprite
+ * Pool might have changed.
+ */
+
+void objutil_invalidate_sprites(void);
+
+
+/**
+ * Return the current sprite cache generation, so that clients holding
+ * resolved sprite names can tell when they need to resolve them again.
+ *
+ * \return		The current sprite cache generation.
+ */
+
+unsigned objutil_get_sprite_generation(void);
+
+
+/**
+ * Terminate the sprite cache, freeing its memory.
+ */
+
+void objutil_terminate_sprites(void);
+
+
+/**
+ * Clear a launch target's cached details, so that the object will be
+ * examined again before it is next launched.
+ *
+ * \param *target	The launch target to clear.
+ */
+
+void objutil_clear_target(struct objutil_target *target);
+
+
+/**
+ * Examine an object referenced by a filename, and update a launch target's
+ * cached details to reflect what was found. No errors are reported, so this
+ * is suitable for revalidating targets in the background.
+ *
+ * \param *object	The filename of the object to examine.
+ * \param *target	The launch target to update.
+ * \return		TRUE if the type or date stamp of the target
+ *			changed; else FALSE.
+ */
+
+osbool objutil_refresh_target(char *object, struct objutil_target *target);
+
+
+/**
+ * Examine an object ahead of it being launched, updating a launch target's
+ * cached details and bringing the parts of the object which the launch will
+ * need into the filing system's cache. No errors are reported.
+ *
+ * \param *object	The filename of the object to examine.
+ * \param *target	The launch target to update.
+ * \return		TRUE if the object can be launched; else FALSE.
+ */
+
+osbool objutil_prefetch_target(char *object, struct objutil_target *target);
+
+
+/**
+ * Launch an object referenced by a supplied filename, using the type held
+ * in a launch target's cache if it is known. The object will only be
+ * examined if its type is unknown, or if the launch fails. The launch is
+ * carried out as a new task, via Wimp_StartTask. Files are run via the
+ * Filer, so no task handle is ever returned for them.
+ *
+ * \param *object	The filename of the object to launch.
+ * \param *target	The launch target holding the object's details.
+ * \param *task		Pointer to a variable to take the handle of the
+ *			new task if it is still running, or NULL.
+ * \return		TRUE if successful; FALSE on error.
+ */
+
+osbool objutil_launch_target(char *object, struct objutil_target *target, wimp_t *task);
+
+
 /**
  * Launch an object referenced by a supplied filename.
  * 
@@ -27,6 +27,8 @@
 
 /* ANSI C header files. */
 
+#include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 /* OSLib header files. */
@@ -52,14 +54,19 @@
 #include "panel.h"
 
 #include "appdb.h"
+#include "backing.h"
 #include "choices.h"
 #include "edit_button.h"
 #include "edit_panel.h"
 #include "filing.h"
 #include "icondb.h"
+#include "latency.h"
+#include "launch.h"
+#include "layout.h"
 #include "main.h"
 #include "objutil.h"
 #include "paneldb.h"
+#include "reach.h"
 
 
 /* Button Window */
@@ -78,8 +85,9 @@
 #define PANEL_MENU_PANEL 4
 #define PANEL_MENU_NEW_PANEL 5
 #define PANEL_MENU_SAVE_LAYOUT 6
-#define PANEL_MENU_CHOICES 7
-#define PANEL_MENU_QUIT 8
+#define PANEL_MENU_LAUNCH_TIMES 7
+#define PANEL_MENU_CHOICES 8
+#define PANEL_MENU_QUIT 9
 
 /* Button Submenu */
 
@@ -91,20 +99,6 @@
 #define PANEL_MENU_PANEL_EDIT 0
 #define PANEL_MENU_PANEL_DELETE 1
 
-/**
- * The possible buttons window positions.
- */
-
-enum panel_position {
-	PANEL_POSITION_NONE = 0,
-	PANEL_POSITION_LEFT = 1,
-	PANEL_POSITION_RIGHT = 2,
-	PANEL_POSITION_VERTICAL = 3,
-	PANEL_POSITION_TOP = 4,
-	PANEL_POSITION_BOTTOM = 8,
-	PANEL_POSITION_HORIZONTAL = 12
-};
-
 /**
  * The reasons that a panel might be on display.
  */
@@ -117,18 +111,223 @@ enum panel_status {
 	PANEL_STATUS_BUTTON_DLOG_OPEN = 8
 };
 
+/**
+ * The layout work which is waiting to be done on the next null poll.
+ */
+
+enum panel_relayout {
+	PANEL_RELAYOUT_NONE = 0,
+	PANEL_RELAYOUT_PANELS = 1,
+	PANEL_RELAYOUT_POSITIONS = 2,
+	PANEL_RELAYOUT_MODE = 4
+};
+
 /**
  * The offset between panel icons and the inset.
  */
 
 #define PANEL_INSET_OFFSET 4
 
+/**
+ * The width of the marker plotted below buttons whose tasks are running.
+ */
+
+#define PANEL_RUNNING_MARKER_WIDTH 16
+
+/**
+ * The time to wait after an object is dropped on a panel for any more
+ * objects from the same drag to arrive, in centiseconds.
+ */
+
+#define PANEL_DROP_DELAY 10
+
+/**
+ * The space allocated for the count of dropped objects which couldn't be
+ * added, when reporting them.
+ */
+
+#define PANEL_DROP_COUNT_LEN 12
+
 /**
  * The maximum size allocated to a validation string when plotting inset icons.
  */
 
 #define PANEL_MAX_VALIDATION_LEN 24
 
+/**
+ * The number of rows beyond each end of the visible area of a scrolling
+ * panel for which button icons are created.
+ */
+
+#define PANEL_SCROLL_MARGIN 2
+
+/**
+ * The interval between background checks of button launch targets, in
+ * centiseconds, once all of the targets which are due have been checked.
+ */
+
+#define PANEL_REVALIDATE_INTERVAL 100
+
+/**
+ * The age, in centiseconds, after which a button's launch target is due to
+ * be checked again in the background.
+ */
+
+#define PANEL_REVALIDATE_AGE 3000
+
+/**
+ * The interval at which the pointer is checked while it is over a panel,
+ * in centiseconds.
+ */
+
+#define PANEL_HOVER_INTERVAL 5
+
+/**
+ * An entry in a panel's display list, holding everything needed to plot
+ * one button's inset icon.
+ */
+
+struct panel_plot {
+	/**
+	 * The icon definition to plot, including its extent.
+	 */
+
+	wimp_icon icon;
+
+	/**
+	 * The validation string for text and sprite icons.
+	 */
+
+	char validation[PANEL_MAX_VALIDATION_LEN];
+
+	/**
+	 * A copy of the button's name, to show if it has no label of its own.
+	 */
+
+	char name[APPDB_NAME_LENGTH];
+
+	/**
+	 * The grid row, along the long axis of the panel, of the button.
+	 */
+
+	int row;
+
+	/**
+	 * The database key of the button.
+	 */
+
+	unsigned key;
+
+	/**
+	 * TRUE if the button's running marker is to be plotted.
+	 */
+
+	osbool running;
+};
+
+/**
+ * An object dropped on to a panel, waiting to be added as a button.
+ */
+
+struct panel_drop {
+	/**
+	 * The filename of the object.
+	 */
+
+	char *object;
+
+	/**
+	 * Pointer to the next dropped object.
+	 */
+
+	struct panel_drop *next;
+};
+
+/**
+ * A button's place when automatically arranging a panel by usage.
+ */
+
+struct panel_arrangement {
+	/**
+	 * The button being arranged.
+	 */
+
+	struct icondb_button *button;
+
+	/**
+	 * The number of times that the button has been launched.
+	 */
+
+	unsigned launches;
+
+	/**
+	 * The position of the button in the buttons database.
+	 */
+
+	os_coord position;
+};
+
+/**
+ * The maximum number of screen modes for which each panel caches its layout.
+ */
+
+#define PANEL_MODE_CACHE_SIZE 4
+
+/**
+ * The calculated grid position of a button in a cached layout.
+ */
+
+struct panel_mode_position {
+	/**
+	 * The database key of the button.
+	 */
+
+	unsigned key;
+
+	/**
+	 * The grid position of the button.
+	 */
+
+	os_coord position;
+};
+
+/**
+ * A panel layout calculated for a particular screen mode, which can be
+ * reused if the mode comes around again.
+ */
+
+struct panel_mode_layout {
+	/**
+	 * The screen details for which the layout was calculated.
+	 */
+
+	struct layout_screen screen;
+
+	/**
+	 * The calculated panel layout.
+	 */
+
+	struct layout_panel layout;
+
+	/**
+	 * The number of buttons in the positions array.
+	 */
+
+	int count;
+
+	/**
+	 * The keys and calculated grid positions of the buttons, in list order.
+	 */
+
+	struct panel_mode_position *positions;
+
+	/**
+	 * The next cached layout, in order of most recent use.
+	 */
+
+	struct panel_mode_layout *next;
+};
+
 /**
  * The buttion instance data block.
  */
@@ -141,99 +340,139 @@ struct panel_block {
 	unsigned panel_id;
 
 	/**
-	 * The location of the panel.
+	 * The icon database to use for the panel.
 	 */
 
-	enum panel_position location;
+	struct icondb_block *icondb;
 
 	/**
-	 * The icon database to use for the panel.
+	 * The layout details for the panel.
 	 */
 
-	struct icondb_block *icondb;
+	struct layout_panel layout;
 
 	/**
-	 * The sort position of the panel.
+	 * The layout details used when the panel was last rebuilt.
 	 */
 
-	int sort;
+	struct layout_panel built_layout;
 
 	/**
-	 * The longitude weight of the panel.
+	 * The screen details used when the panel was last rebuilt.
 	 */
 
-	int longitude_weight;
+	struct layout_screen built_screen;
 
 	/**
-	 * The number of columns in the visible grid.
+	 * TRUE if the panel's contents have changed since it was last rebuilt.
 	 */
 
-	int grid_depth;
+	osbool dirty;
 
 	/**
-	 * The number of rows in the visible grid.
+	 * The layouts calculated for recently used screen modes.
 	 */
 
-	os_coord grid_dimensions;
+	struct panel_mode_layout *mode_cache;
 
 	/**
-	 * The origin of the button grid (in OS units).
+	 * TRUE if the panel is waiting for a deferred relayout.
 	 */
 
-	os_coord origin;
+	osbool relayout;
 
 	/**
-	 * Indicate whether the window is currently "open" (TRUE) or "closed" (FALSE).
+	 * The union of the work area rectangles which need to be redrawn
+	 * following changes to the panel's buttons.
 	 */
 
-	osbool panel_is_open;
+	os_box damage;
 
 	/**
-	 * Track reasons why a panel might be open.
+	 * TRUE if the damage rectangle holds an area to be redrawn.
 	 */
 
-	enum panel_status open_status;
+	osbool damaged;
 
 	/**
-	 * The handle of the buttons window.
+	 * The first grid row for which button icons exist.
 	 */
 
-	wimp_w window;
+	int materialised_first;
+
+	/**
+	 * The last grid row for which button icons exist.
+	 */
+
+	int materialised_last;
+
+	/**
+	 * The display list used to redraw the panel, or NULL.
+	 */
+
+	struct panel_plot *display;
+
+	/**
+	 * The number of entries in the display list.
+	 */
+
+	int display_count;
+
+	/**
+	 * An index into the display list, giving the first entry on each
+	 * grid row, followed by the number of entries; or NULL.
+	 */
+
+	int *display_rows;
 
 	/**
-	 * The lower (bottom) coordinate of the buttons window.
+	 * The number of grid rows in the display list index.
 	 */
 
-	int min_longitude;
+	int display_row_count;
 
 	/**
-	 * The upper (top) coordinate of the buttons window.
+	 * TRUE if the display list reflects the current buttons.
 	 */
 
-	int max_longitude;
+	osbool display_valid;
 
 	/**
-	 * The size of a grid square (in OS units).
+	 * The sprite cache generation at which the display list was built.
 	 */
 
-	int grid_square;
+	unsigned display_sprite_generation;
 
 	/**
-	 * The spacing between grid squares (in OS units).
+	 * The backing store holding the rendered display list, or NULL
+	 * to plot the display list directly.
 	 */
-	int grid_spacing;
+
+	struct backing_block *backing;
+
+	/**
+	 * TRUE if the backing store reflects the current display list.
+	 */
+
+	osbool backing_valid;
+
+	/**
+	 * Indicate whether the window is currently "open" (TRUE) or "closed" (FALSE).
+	 */
+
+	osbool panel_is_open;
 
 	/**
-	 * The dimensions of one button slab (in grid squares).
+	 * Track reasons why a panel might be open.
 	 */
 
-	os_coord slab_grid_dimensions;
+	enum panel_status open_status;
 
 	/**
-	 * The dimensions of one button slab (in OS units).
+	 * The handle of the buttons window.
 	 */
 
-	os_coord slab_os_dimensions;
+	wimp_w window;
 
 	/**
 	 * Does the panel respond to mouseover events.
@@ -253,6 +492,19 @@ struct panel_block {
 
 	os_t auto_close_delay;
 
+	/**
+	 * The objects dropped on to the panel which are waiting to be added
+	 * as buttons, oldest first.
+	 */
+
+	struct panel_drop *drops;
+
+	/**
+	 * The grid cell on to which the first waiting object was dropped.
+	 */
+
+	os_coord drop_cell;
+
 	/**
 	 * The next instance in the list, or NULL.
 	 */
@@ -293,44 +545,152 @@ static wimp_icon panel_icon_text_def;
 static wimp_icon panel_icon_sprite_def;
 
 /**
- * The width of the current mode, in OS Units.
+ * The details of the current screen mode.
+ */
+
+static struct layout_screen panel_screen;
+
+/**
+ * The current label generation, which is incremented whenever the desktop
+ * font or mode changes to invalidate all of the cached button labels.
+ */
+
+static unsigned panel_label_generation = 1;
+
+/**
+ * TRUE if panels should be redrawn from a backing store sprite.
+ */
+
+static osbool panel_backing_enabled = FALSE;
+
+/**
+ * The maximum size of a panel's backing store sprite, in bytes.
+ */
+
+static int panel_backing_limit = 0;
+
+/**
+ * TRUE if panels should scroll along their long axis when their buttons
+ * don't fit, instead of growing out from the edge of the screen.
+ */
+
+static osbool panel_scroll_enabled = FALSE;
+
+/**
+ * TRUE if panel buttons are hit-tested by Launcher instead of being
+ * created as Wimp icons.
+ */
+
+static osbool panel_iconless = FALSE;
+
+/**
+ * TRUE if the buttons in each panel are arranged by how often they are
+ * used, instead of by their positions in the buttons database.
+ */
+
+static osbool panel_auto_arrange = FALSE;
+
+/**
+ * The layout work waiting to be carried out on the next null poll.
+ */
+
+static enum panel_relayout panel_relayout_pending = PANEL_RELAYOUT_NONE;
+
+/**
+ * The time at which the next button launch target is due to be checked.
+ */
+
+static os_t panel_revalidate_time = 0;
+
+/**
+ * The panel holding the next button whose launch target is to be checked,
+ * or NULL to start again from the first panel.
+ */
+
+static struct panel_block *panel_revalidate_panel = NULL;
+
+/**
+ * The next button in panel_revalidate_panel whose launch target is to be
+ * checked, or NULL if the end of the panel's buttons has been reached.
+ */
+
+static struct icondb_button *panel_revalidate_button = NULL;
+
+/**
+ * The panel which the pointer is over, or NULL.
+ */
+
+static struct panel_block *panel_hover_panel = NULL;
+
+/**
+ * The key of the button which the pointer is resting on, or APPDB_NULL_KEY.
+ */
+
+static unsigned panel_hover_key = APPDB_NULL_KEY;
+
+/**
+ * The time at which the pointer came to rest on the current button.
+ */
+
+static os_t panel_hover_time = 0;
+
+/**
+ * TRUE if the target of the button under the pointer has been prefetched.
+ */
+
+static osbool panel_hover_prefetched = FALSE;
+
+/**
+ * The time that the pointer must rest on a button before its target is
+ * prefetched, in centiseconds, or zero to disable prefetching.
+ */
+
+static int panel_prefetch_delay = 0;
+
+/**
+ * The longest time to spend checking button launch targets on each null
+ * poll, in centiseconds.
  */
 
-static int panel_mode_width;
+static int panel_validate_budget = 0;
 
 /**
- * The height of the current mode, in OS Units.
+ * The number of button presses whose targets had been prefetched.
  */
 
-static int panel_mode_height;
+static unsigned panel_prefetch_hits = 0;
 
 /**
- * The height of the iconbar, in OS Units.
+ * The number of button presses whose targets had not been prefetched.
  */
 
-static int panel_iconbar_height;
+static unsigned panel_prefetch_misses = 0;
 
 /**
- * The number of OS units per pixel horizontally in the current mode.
+ * The reachability generation for which the buttons were last shaded.
  */
 
-static int panel_mode_x_units_per_pixel;
+static unsigned panel_reach_generation = 0;
 
 /**
- * The number of OS units per pixel vertically in the current mode.
+ * TRUE if pressing a button whose task is running should bring that task to
+ * the front instead of launching it again.
  */
 
-static int panel_mode_y_units_per_pixel;
+static osbool panel_switch_to_running = FALSE;
 
 /**
- * The width of the panel sidebar on vertical panels.
+ * TRUE if there are objects dropped on to the panels waiting to be added
+ * as buttons.
  */
-static int panel_sidebar_width;
+
+static osbool panel_drops_waiting = FALSE;
 
 /**
- * The height of the panel sidebar on horizontal panels.
+ * The time after which the waiting dropped objects are to be added.
  */
-static int panel_sidebar_height;
+
+static os_t panel_drop_time = 0;
 
 /**
  * The handle of the main menu.
@@ -355,6 +715,8 @@ static os_coord panel_menu_coordinate;
 /* Static Function Prototypes. */
 
 static struct panel_block *panel_create_instance(unsigned key);
+static void panel_create_window(struct panel_block *windat);
+static void panel_recreate_window(struct panel_block *windat);
 static void panel_delete_instance(struct panel_block *windat);
 static void panel_update_instance_from_db(struct panel_block *windat);
 
@@ -367,26 +729,57 @@ static void panel_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 static void panel_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *selection);
 static void panel_menu_close(wimp_w w, wimp_menu *menu);
 static void panel_redraw_handler(wimp_draw *redraw);
+static void panel_plot_base(os_box *inset, int x, int y);
+static void panel_plot_running_marker(os_box *inset, int x, int y);
+static void panel_scroll_handler(wimp_scroll *scroll);
 static osbool panel_message_mode_change(wimp_message *message);
+static osbool panel_message_font_changed(wimp_message *message);
 
 static void panel_update_mode_details(void);
 
 static void panel_toggle_window(struct panel_block *windat);
+static void panel_set_open(struct panel_block *windat, osbool open);
 static void panel_reopen_window(struct panel_block *windat);
 static void panel_open_window(wimp_open *open);
 static void panel_update_positions(void);
-static int compare_panels(const void *p, const void *q);
 static void panel_update_window_extent(struct panel_block *windat);
 
 static void panel_update_grid_info(struct panel_block *windat);
+static void panel_update_layout(struct panel_block *windat);
+static void panel_set_all_dirty(void);
+static void panel_schedule_relayout(struct panel_block *windat, enum panel_relayout action);
+static void panel_process_relayout(void);
+static osbool panel_revalidate_target(os_t now);
+static void panel_update_reachability(void);
+static void panel_track_hover(os_t now);
 
 static void panel_add_buttons_from_db(struct panel_block *windat);
+static void panel_arrange_buttons(struct panel_block *windat);
+static int panel_compare_arrangements(const void *p, const void *q);
 static void panel_reflow_buttons(struct panel_block *windat);
+static osbool panel_restore_mode_layout(struct panel_block *windat);
+static void panel_store_mode_layout(struct panel_block *windat);
+static void panel_flush_mode_cache(struct panel_block *windat);
 static void panel_rebuild_window(struct panel_block *windat);
-static void panel_empty_window(struct panel_block *windat);
+static void panel_delete_icon(struct panel_block *windat, struct icondb_button *button);
 
 static void panel_create_icon(struct panel_block *windat, struct icondb_button *button);
-static void panel_press(struct panel_block *windat, wimp_i icon);
+static osbool panel_update_label(struct icondb_button *button, char *name, int width);
+static void panel_get_button_extent(struct panel_block *windat, struct icondb_button *button, os_box *extent);
+static void panel_add_damage(struct panel_block *windat, os_box *box);
+static void panel_flush_damage(struct panel_block *windat);
+static void panel_get_materialised_rows(struct panel_block *windat, int *first, int *last);
+static void panel_release_button(struct panel_block *windat, struct icondb_button *button);
+static void panel_build_display_list(struct panel_block *windat);
+static int panel_compare_plots(const void *p, const void *q);
+static void panel_build_backing_store(struct panel_block *windat);
+static void panel_press(struct panel_block *windat, struct icondb_button *button, os_t time);
+static void panel_launch_callback(unsigned key, enum launch_state state, struct objutil_target *target);
+static void panel_set_pressed(struct panel_block *windat, struct icondb_button *button, osbool pressed);
+static void panel_set_unreachable(struct panel_block *windat, struct icondb_button *button, osbool unreachable);
+static void panel_set_running(struct panel_block *windat, struct icondb_button *button, osbool running);
+static void panel_redraw_button(struct panel_block *windat, struct icondb_button *button);
+static struct icondb_button *panel_find_button(struct panel_block *windat, wimp_pointer *pointer);
 
 static void panel_open_panel_dialogue(wimp_pointer *pointer, struct panel_block *windat);
 static osbool panel_process_panel_dialogue(struct paneldb_entry *app, void *data);
@@ -396,6 +789,12 @@ static void panel_open_button_dialogue(wimp_pointer *pointer, struct panel_block
 static osbool panel_process_button_dialogue(struct appdb_entry *entry, void *data);
 static osbool panel_delete_button(struct panel_block *windat, struct icondb_button *button);
 
+static osbool panel_message_data_load(wimp_message *message);
+static void panel_add_dropped_buttons(struct panel_block *windat);
+static void panel_discard_drops(struct panel_block *windat);
+static osbool panel_find_free_cell(char *occupied, int depth, int rows, os_coord *size, os_coord *target, os_coord *cell);
+static void panel_fill_cells(char *occupied, int depth, int rows, os_coord *size, os_coord *position);
+
 static struct panel_block *panel_find_id(unsigned id);
 
 
@@ -420,21 +819,32 @@ void panel_initialise(void)
 
 	panel_window_def->icon_count = 1;
 
+	/* Ask for scroll requests, so that scrolling panels can be moved
+	 * with the mouse wheel.
+	 */
+
+	panel_window_def->flags |= wimp_WINDOW_SCROLL_REPEAT;
+
 	panel_icon_base_def.icon = panel_window_def->icons[PANEL_ICON_BASE_TEMPLATE];
 	panel_icon_text_def = panel_window_def->icons[PANEL_ICON_TEXT_TEMPLATE];
 	panel_icon_sprite_def = panel_window_def->icons[PANEL_ICON_SPRITE_TEMPLATE];
 
 	/* Work out the size of the sidebar icon. */
 
-	panel_sidebar_width = panel_window_def->icons[PANEL_ICON_SIDEBAR].extent.x1 -
+	panel_screen.sidebar_width = panel_window_def->icons[PANEL_ICON_SIDEBAR].extent.x1 -
 			panel_window_def->icons[PANEL_ICON_SIDEBAR].extent.x0;
 
-	panel_sidebar_height = panel_window_def->icons[PANEL_ICON_SIDEBAR].extent.y1 -
+	panel_screen.sidebar_height = panel_window_def->icons[PANEL_ICON_SIDEBAR].extent.y1 -
 			panel_window_def->icons[PANEL_ICON_SIDEBAR].extent.y0;
 
-	/* Watch out for Message_ModeChange. */
+	/* Watch out for Message_ModeChange and Message_FontChanged. */
 
 	event_add_message_handler(message_MODE_CHANGE, EVENT_MESSAGE_INCOMING, panel_message_mode_change);
+	event_add_message_handler(message_FONT_CHANGED, EVENT_MESSAGE_INCOMING, panel_message_font_changed);
+
+	/* Watch out for objects being dropped on to the panels. */
+
+	event_add_message_handler(message_DATA_LOAD, EVENT_MESSAGE_INCOMING, panel_message_data_load);
 
 	/* Initialise the Edit dialogues. */
 
@@ -480,33 +890,33 @@ static struct panel_block *panel_create_instance(unsigned key)
 		return NULL;
 
 	new->panel_id = key;
-	new->grid_depth = 0;
-	new->grid_dimensions.x = 0;
-	new->grid_dimensions.y = 0;
-	new->origin.x = 0;
-	new->origin.y = 0;
 	new->panel_is_open = FALSE;
 	new->open_status = PANEL_STATUS_CLOSED;
-	new->min_longitude = 0;
-	new->max_longitude = 0;
 	new->auto_mouseover = config_opt_read("MouseOver");
 	new->auto_open_delay = config_int_read("OpenDelay");
 	new->auto_close_delay = 10;
+	new->drops = NULL;
 
-	new->icondb = icondb_create_instance();
+	layout_initialise_panel(&(new->layout));
+	new->dirty = TRUE;
+	new->relayout = FALSE;
+	new->mode_cache = NULL;
+	new->damaged = FALSE;
+	new->materialised_first = 0;
+	new->materialised_last = -1;
 
-	new->window = wimp_create_window(panel_window_def);
-	ihelp_add_window(new->window, "Launch", NULL);
-	event_add_window_user_data(new->window, new);
-	event_add_window_redraw_event(new->window, panel_redraw_handler);
-	event_add_window_open_event(new->window, panel_open_window);
-	event_add_window_mouse_event(new->window, panel_click_handler);
-	event_add_window_pointer_entering_event(new->window, panel_pointer_entering_handler);
-	event_add_window_pointer_leaving_event(new->window, panel_pointer_leaving_handler);
-	event_add_window_menu(new->window, panel_menu);
-	event_add_window_menu_prepare(new->window, panel_menu_prepare);
-	event_add_window_menu_selection(new->window, panel_menu_selection);
-	event_add_window_menu_close(new->window, panel_menu_close);
+	new->display = NULL;
+	new->display_count = 0;
+	new->display_rows = NULL;
+	new->display_row_count = 0;
+
+	new->backing = NULL;
+	new->backing_valid = FALSE;
+	new->display_valid = FALSE;
+
+	new->icondb = icondb_create_instance();
+
+	panel_create_window(new);
 
 	/* Link the window in to the data structure. */
 
@@ -517,6 +927,66 @@ static struct panel_block *panel_create_instance(unsigned key)
 }
 
 
+/**
+ * Create the Wimp window for a panel instance, and register its event
+ * handlers.
+ *
+ * \param *windat		The panel instance to create the window for.
+ */
+
+static void panel_create_window(struct panel_block *windat)
+{
+	if (windat == NULL)
+		return;
+
+	windat->window = wimp_create_window(panel_window_def);
+	ihelp_add_window(windat->window, "Launch", NULL);
+	event_add_window_user_data(windat->window, windat);
+	event_add_window_redraw_event(windat->window, panel_redraw_handler);
+	event_add_window_scroll_event(windat->window, panel_scroll_handler);
+	event_add_window_open_event(windat->window, panel_open_window);
+	event_add_window_mouse_event(windat->window, panel_click_handler);
+	event_add_window_pointer_entering_event(windat->window, panel_pointer_entering_handler);
+	event_add_window_pointer_leaving_event(windat->window, panel_pointer_leaving_handler);
+	event_add_window_menu(windat->window, panel_menu);
+	event_add_window_menu_prepare(windat->window, panel_menu_prepare);
+	event_add_window_menu_selection(windat->window, panel_menu_selection);
+	event_add_window_menu_close(windat->window, panel_menu_close);
+}
+
+
+/**
+ * Replace the Wimp window of a panel instance with a new one created from
+ * the current window template. The buttons lose their icons with the old
+ * window, and are rebuilt in the new one when the panel is next laid out.
+ *
+ * \param *windat		The panel instance to recreate the window for.
+ */
+
+static void panel_recreate_window(struct panel_block *windat)
+{
+	struct icondb_button	*button;
+
+	if (windat == NULL)
+		return;
+
+	event_delete_window(windat->window);
+	ihelp_remove_window(windat->window);
+	wimp_delete_window(windat->window);
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+		button->window = NULL;
+		button->icon = wimp_ICON_WINDOW;
+	}
+
+	panel_create_window(windat);
+
+	windat->dirty = TRUE;
+	windat->display_valid = FALSE;
+	windat->backing_valid = FALSE;
+}
+
+
 /**
  * Delete a panel instance.
  * 
@@ -546,8 +1016,10 @@ static void panel_delete_instance(struct panel_block *windat)
 		key = appdb_get_next_key(key);
 
 		app = appdb_get_button_info(last_key, NULL);
-		if (app != NULL && app->panel == windat->panel_id)
+		if (app != NULL && app->panel == windat->panel_id) {
+			latency_forget(last_key);
 			appdb_delete_key(last_key);
+		}
 	}
 
 	/* Delete the panel from the database. */
@@ -558,6 +1030,28 @@ static void panel_delete_instance(struct panel_block *windat)
 
 	icondb_destroy_instance(windat->icondb);
 
+	if (windat->display != NULL)
+		heap_free(windat->display);
+
+	if (windat->display_rows != NULL)
+		heap_free(windat->display_rows);
+
+	backing_destroy(windat->backing);
+
+	panel_flush_mode_cache(windat);
+
+	panel_discard_drops(windat);
+
+	if (panel_hover_panel == windat) {
+		panel_hover_panel = NULL;
+		panel_hover_key = APPDB_NULL_KEY;
+	}
+
+	if (panel_revalidate_panel == windat) {
+		panel_revalidate_panel = NULL;
+		panel_revalidate_button = NULL;
+	}
+
 	/* Delink the panel from the list. */
 
 	if (panel_list == windat) {
@@ -594,24 +1088,24 @@ static void panel_update_instance_from_db(struct panel_block *windat)
 
 	switch (panel->position) {
 	case PANELDB_POSITION_LEFT:
-		windat->location = PANEL_POSITION_LEFT;
+		windat->layout.location = LAYOUT_POSITION_LEFT;
 		break;
 	case PANELDB_POSITION_RIGHT:
-		windat->location = PANEL_POSITION_RIGHT;
+		windat->layout.location = LAYOUT_POSITION_RIGHT;
 		break;
 	case PANELDB_POSITION_TOP:
-		windat->location = PANEL_POSITION_TOP;
+		windat->layout.location = LAYOUT_POSITION_TOP;
 		break;
 	case PANELDB_POSITION_BOTTOM:
-		windat->location = PANEL_POSITION_BOTTOM;
+		windat->layout.location = LAYOUT_POSITION_BOTTOM;
 		break;
 	default:
-		windat->location = PANEL_POSITION_LEFT;
+		windat->layout.location = LAYOUT_POSITION_LEFT;
 		break;
 	}
 
-	windat->longitude_weight = panel->width;
-	windat->sort = panel->sort;
+	windat->layout.longitude_weight = panel->width;
+	windat->layout.sort = panel->sort;
 }
 
 
@@ -624,17 +1118,54 @@ void panel_refresh_choices(void)
 {
 	struct panel_block *windat = panel_list;
 
-	panel_sidebar_width = config_int_read("SideBarSize");
-	panel_sidebar_height = panel_sidebar_width;
+	panel_screen.sidebar_width = config_int_read("SideBarSize");
+	panel_screen.sidebar_height = panel_screen.sidebar_width;
+
+	panel_backing_enabled = config_opt_read("BackingStore");
+	panel_scroll_enabled = config_opt_read("ScrollPanels");
+
+	if (panel_iconless != config_opt_read("IconlessPanels")) {
+		panel_iconless = config_opt_read("IconlessPanels");
+
+		/* Without icons, clicks on the buttons land on the work area,
+		 * so it must report them. The Wimp fixes a window's work area
+		 * button type when the window is created, so any existing
+		 * panels must be given new windows.
+		 */
+
+		panel_window_def->work_flags &= ~wimp_ICON_BUTTON_TYPE;
+		if (panel_iconless)
+			panel_window_def->work_flags |= wimp_BUTTON_CLICK << wimp_ICON_BUTTON_TYPE_SHIFT;
+
+		for (windat = panel_list; windat != NULL; windat = windat->next)
+			panel_recreate_window(windat);
+
+		windat = panel_list;
+	}
+
+	if (panel_auto_arrange != config_opt_read("AutoArrange")) {
+		panel_auto_arrange = config_opt_read("AutoArrange");
+
+		for (windat = panel_list; windat != NULL; windat = windat->next)
+			panel_add_buttons_from_db(windat);
+
+		windat = panel_list;
+	}
+
+	panel_backing_limit = config_int_read("BackingStoreLimit") * 1024;
+	panel_prefetch_delay = config_int_read("PrefetchDelay");
+	panel_validate_budget = config_int_read("ValidateBudget");
+	panel_switch_to_running = config_opt_read("SwitchToRunning");
 
 	while (windat != NULL) {
 		windat->auto_mouseover = config_opt_read("MouseOver");
 		windat->auto_open_delay = config_int_read("OpenDelay");
+		windat->backing_valid = FALSE;
 
 		windat = windat->next;
 	}
 
-	panel_update_positions();
+	panel_schedule_relayout(NULL, PANEL_RELAYOUT_POSITIONS);
 }
 
 
@@ -646,11 +1177,17 @@ void panel_refresh_choices(void)
 
 static void panel_click_handler(wimp_pointer *pointer)
 {
-	struct panel_block *windat;
+	struct panel_block	*windat;
+	struct icondb_button	*button;
+	os_t			time;
 
 	if (pointer == NULL)
 		return;
 
+	/* Note the time of the click, to measure launch times from. */
+
+	time = os_read_monotonic_time();
+
 	windat = event_get_window_user_data(pointer->w);
 	if (windat == NULL)
 		return;
@@ -661,7 +1198,11 @@ static void panel_click_handler(wimp_pointer *pointer)
 		if (pointer->i == PANEL_ICON_SIDEBAR) {
 			panel_toggle_window(windat);
 		} else {
-			panel_press(windat, pointer->i);
+			button = panel_find_button(windat, pointer);
+			if (button == NULL)
+				break;
+
+			panel_press(windat, button, time);
 
 			if (pointer->buttons == wimp_CLICK_SELECT)
 				panel_toggle_window(windat);
@@ -690,6 +1231,9 @@ static void panel_pointer_entering_handler(wimp_entering *entering)
 
 	windat->open_status |= PANEL_STATUS_POINTER_OVER;
 
+	panel_hover_panel = windat;
+	panel_hover_key = APPDB_NULL_KEY;
+
 	if (windat->auto_mouseover && windat->open_status == PANEL_STATUS_POINTER_OVER)
 		event_add_single_callback(entering->w, windat->auto_open_delay, panel_pointer_entering_callback, windat);
 }
@@ -711,9 +1255,7 @@ static osbool panel_pointer_entering_callback(os_t time, void *data)
 	if (windat == NULL || !windat->auto_mouseover || windat->open_status != PANEL_STATUS_POINTER_OVER)
 		return TRUE;
 
-	windat->panel_is_open = TRUE;
-
-	panel_reopen_window(windat);
+	panel_set_open(windat, TRUE);
 
 	return TRUE;
 }
@@ -738,6 +1280,11 @@ static void panel_pointer_leaving_handler(wimp_leaving *leaving)
 
 	windat->open_status &= ~PANEL_STATUS_POINTER_OVER;
 
+	if (panel_hover_panel == windat) {
+		panel_hover_panel = NULL;
+		panel_hover_key = APPDB_NULL_KEY;
+	}
+
 	if (windat->auto_mouseover)
 		event_add_single_callback(leaving->w, windat->auto_close_delay, panel_pointer_leaving_callback, windat);
 }
@@ -759,9 +1306,7 @@ static osbool panel_pointer_leaving_callback(os_t time, void *data)
 	if (!windat->auto_mouseover || !windat->auto_mouseover || windat->open_status != PANEL_STATUS_CLOSED)
 		return TRUE;
 
-	windat->panel_is_open = FALSE;
-
-	panel_reopen_window(windat);
+	panel_set_open(windat, FALSE);
 
 	return TRUE;
 }
@@ -779,7 +1324,7 @@ static void panel_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 {
 	wimp_window_state	window;
 	struct panel_block	*windat;
-	os_coord		click;
+	struct layout_coord	click, cell;
 
 
 	if (pointer == NULL)
@@ -789,13 +1334,10 @@ static void panel_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 	if (windat == NULL)
 		return;
 
-	if (pointer->i == wimp_ICON_WINDOW || pointer->i == PANEL_ICON_SIDEBAR)
-		panel_menu_icon = NULL;
-	else
-		panel_menu_icon = icondb_find_icon(windat->icondb, pointer->w, pointer->i);
+	panel_menu_icon = panel_find_button(windat, pointer);
 
 	menus_shade_entry(panel_menu, PANEL_MENU_BUTTON, (panel_menu_icon == NULL) ? TRUE : FALSE);
-	menus_shade_entry(panel_menu, PANEL_MENU_NEW_BUTTON, (pointer->i == wimp_ICON_WINDOW) ? FALSE : TRUE);
+	menus_shade_entry(panel_menu, PANEL_MENU_NEW_BUTTON, (pointer->i == wimp_ICON_WINDOW && panel_menu_icon == NULL) ? FALSE : TRUE);
 	menus_shade_entry(panel_sub_menu, PANEL_MENU_PANEL_DELETE, (panel_list == NULL || panel_list->next == NULL) ? TRUE : FALSE);
 
 	window.w = w;
@@ -806,39 +1348,12 @@ static void panel_menu_prepare(wimp_w w, wimp_menu *menu, wimp_pointer *pointer)
 	click.x = (pointer->pos.x - window.visible.x0) + window.xscroll;
 	click.y = (pointer->pos.y - window.visible.y1) + window.yscroll;
 
-	/* Adjust to OS units in the grid orientation. */
-
-	switch(windat->location) {
-	case PANEL_POSITION_LEFT:
-		panel_menu_coordinate.x = windat->origin.x - click.x;
-		panel_menu_coordinate.y = windat->origin.y - click.y;
-		break;
-
-	case PANEL_POSITION_RIGHT:
-		panel_menu_coordinate.x = click.x - windat->origin.x;
-		panel_menu_coordinate.y = windat->origin.y - click.y;
-		break;
-
-	case PANEL_POSITION_TOP:
-		panel_menu_coordinate.x = click.y - windat->origin.y;
-		panel_menu_coordinate.y = click.x - windat->origin.x;
-		break;
-
-	case PANEL_POSITION_BOTTOM:
-		panel_menu_coordinate.x = windat->origin.y - click.y;
-		panel_menu_coordinate.y = click.x - windat->origin.x;
-		break;
-
-	case PANEL_POSITION_HORIZONTAL:
-	case PANEL_POSITION_VERTICAL:
-	case PANEL_POSITION_NONE:
-		break;
-	}
-
 	/* Convert to grid squares. */
 
-	panel_menu_coordinate.x = panel_menu_coordinate.x / (windat->grid_square + windat->grid_spacing);
-	panel_menu_coordinate.y = panel_menu_coordinate.y / (windat->grid_square + windat->grid_spacing);
+	layout_get_grid_cell(&(windat->layout), &click, &cell);
+
+	panel_menu_coordinate.x = cell.x;
+	panel_menu_coordinate.y = cell.y;
 
 	/* Track that the menu is open. */
 
@@ -912,6 +1427,10 @@ static void panel_menu_selection(wimp_w w, wimp_menu *menu, wimp_selection *sele
 		filing_save("Buttons");
 		break;
 
+	case PANEL_MENU_LAUNCH_TIMES:
+		latency_show_report();
+		break;
+
 	case PANEL_MENU_CHOICES:
 		choices_open_window(&pointer);
 		break;
@@ -953,11 +1472,10 @@ static void panel_redraw_handler(wimp_draw *redraw)
 {
 	osbool			more;
 	os_coord		origin;
-	os_box			area;
-	char			*sprite, validation[PANEL_MAX_VALIDATION_LEN];
+	struct layout_box	area;
+	int			i, start, end, first, last;
 	struct panel_block	*windat;
-	struct icondb_button	*button;
-	struct appdb_entry	*app;
+	struct panel_plot	*plot;
 
 	if (redraw == NULL)
 		return;
@@ -966,10 +1484,13 @@ static void panel_redraw_handler(wimp_draw *redraw)
 	if (windat == NULL)
 		return;
 
-	/* Initialise the validation string. */
+	/* Bring the display list up to date, if required. */
 
-	validation[0] = 'S';
-	panel_icon_text_def.data.indirected_text_and_sprite.validation = validation;
+	if (!windat->display_valid || windat->display_sprite_generation != objutil_get_sprite_generation())
+		panel_build_display_list(windat);
+
+	if (!windat->backing_valid)
+		panel_build_backing_store(windat);
 
 	/* Perform the redraw. */
 
@@ -986,46 +1507,54 @@ static void panel_redraw_handler(wimp_draw *redraw)
 		area.y0 = redraw->clip.y0 - origin.y;
 		area.y1 = redraw->clip.y1 - origin.y;
 
-		/* Scan the inset panels, to find those that intersect. */
+		/* If there's a backing store, a single plot covers everything. */
 
-		button = icondb_get_list(windat->icondb);
+		if (windat->backing != NULL && backing_plot(windat->backing, &origin)) {
+			more = wimp_get_rectangle(redraw);
+			continue;
+		}
 
-		while (button != NULL) {
-			if (area.x0 < button->inset.x1 && area.x1 > button->inset.x0 &&
-					area.y0 < button->inset.y1 && area.y1 > button->inset.y0) {
-				app = appdb_get_button_info(button->key, NULL);
-
-				/* Find a sprite that's in the pool. */
-
-				sprite = app->sprite;
-
-				if (!objutil_test_sprite(sprite))
-					sprite = "file_xxx";
-
-				/* Plot an appropriate icon. */
-
-				if (app != NULL) {
-					if (app->show_name) {
-						if (button->text != NULL)
-							panel_icon_text_def.data.indirected_text_and_sprite.text = button->text;
-						else
-							panel_icon_text_def.data.indirected_text_and_sprite.text = app->name;
-						panel_icon_text_def.data.indirected_text_and_sprite.size =
-								strlen(panel_icon_text_def.data.indirected_text_and_sprite.text) + 1;
-
-						string_copy(validation + 1, sprite, PANEL_MAX_VALIDATION_LEN - 1);
-						panel_icon_text_def.extent = button->inset;
-						wimp_plot_icon(&panel_icon_text_def);
-					} else {
-						panel_icon_sprite_def.data.indirected_sprite.id = (osspriteop_id) sprite;
-						panel_icon_sprite_def.data.indirected_sprite.size = strlen(sprite) + 1;
-						panel_icon_sprite_def.extent = button->inset;
-						wimp_plot_icon(&panel_icon_sprite_def);
-					}
-				}
-			}
+		/* Find the part of the display list which covers the rows
+		 * that the clip area touches; if there's no row index, fall
+		 * back to scanning all of the buttons.
+		 */
 
-			button = button->next;
+		if (windat->display_rows == NULL) {
+			start = 0;
+			end = windat->display_count;
+		} else if (layout_get_row_range(&(windat->layout), &area, &first, &last) &&
+				first < windat->display_row_count) {
+			if (last >= windat->display_row_count)
+				last = windat->display_row_count - 1;
+
+			start = windat->display_rows[first];
+			end = windat->display_rows[last + 1];
+		} else {
+			start = 0;
+			end = 0;
+		}
+
+		/* Plot the inset icons whose slabs intersect, allowing for the
+		 * running markers in the space below them. Without Wimp icons
+		 * there's nothing else to draw the base slabs, so they must
+		 * be plotted first.
+		 */
+
+		for (i = start; i < end; i++) {
+			plot = windat->display + i;
+
+			if (area.x0 < plot->icon.extent.x1 + PANEL_INSET_OFFSET &&
+					area.x1 > plot->icon.extent.x0 - PANEL_INSET_OFFSET &&
+					area.y0 < plot->icon.extent.y1 + PANEL_INSET_OFFSET &&
+					area.y1 > plot->icon.extent.y0 - PANEL_INSET_OFFSET) {
+				if (panel_iconless)
+					panel_plot_base(&(plot->icon.extent), 0, 0);
+
+				wimp_plot_icon(&(plot->icon));
+
+				if (plot->running)
+					panel_plot_running_marker(&(plot->icon.extent), origin.x, origin.y);
+			}
 		}
 
 		more = wimp_get_rectangle(redraw);
@@ -1033,6 +1562,107 @@ static void panel_redraw_handler(wimp_draw *redraw)
 }
 
 
+/**
+ * Plot the base slab of a button, as the Wimp draws it for a button's
+ * base icon.
+ *
+ * \param *inset		The inset extent of the button, in work area
+ *				coordinates.
+ * \param x			The X offset from work area to plot coordinates.
+ * \param y			The Y offset from work area to plot coordinates.
+ */
+
+static void panel_plot_base(os_box *inset, int x, int y)
+{
+	wimp_icon icon;
+
+	icon = panel_icon_base_def.icon;
+
+	icon.extent.x0 = x + inset->x0 - PANEL_INSET_OFFSET;
+	icon.extent.y0 = y + inset->y0 - PANEL_INSET_OFFSET;
+	icon.extent.x1 = x + inset->x1 + PANEL_INSET_OFFSET;
+	icon.extent.y1 = y + inset->y1 + PANEL_INSET_OFFSET;
+
+	wimp_plot_icon(&icon);
+}
+
+
+/**
+ * Plot the marker shown below a button whose task is running.
+ *
+ * \param *inset		The inset extent of the button, in work area
+ *				coordinates.
+ * \param x			The X offset from work area to screen.
+ * \param y			The Y offset from work area to screen.
+ */
+
+static void panel_plot_running_marker(os_box *inset, int x, int y)
+{
+	int centre;
+
+	centre = x + (inset->x0 + inset->x1) / 2;
+
+	wimp_set_colour(wimp_COLOUR_BLACK);
+	os_plot(os_MOVE_TO, centre - PANEL_RUNNING_MARKER_WIDTH / 2, y + inset->y0 - PANEL_INSET_OFFSET);
+	os_plot(os_PLOT_RECTANGLE | os_PLOT_TO, centre + PANEL_RUNNING_MARKER_WIDTH / 2 - 1, y + inset->y0 - (PANEL_INSET_OFFSET / 2) - 1);
+}
+
+
+/**
+ * Process scroll requests in a Buttons window, moving scrolling panels
+ * along their long axis.
+ *
+ * \param *scroll		The scroll event block to handle.
+ */
+
+static void panel_scroll_handler(wimp_scroll *scroll)
+{
+	struct panel_block	*windat;
+	int			direction, step, first, last;
+
+	if (scroll == NULL)
+		return;
+
+	windat = event_get_window_user_data(scroll->w);
+	if (windat == NULL || !windat->layout.scrolling)
+		return;
+
+	/* Work out which way to move: the mouse wheel gives vertical
+	 * requests, which are used for horizontal panels too.
+	 */
+
+	if (windat->layout.location & LAYOUT_POSITION_HORIZONTAL)
+		direction = (scroll->xmin != 0) ? scroll->xmin : -scroll->ymin;
+	else
+		direction = -scroll->ymin;
+
+	if (direction == 0)
+		return;
+
+	step = windat->layout.grid_square + windat->layout.grid_spacing;
+
+	if (direction == 2 || direction == -2)
+		step = windat->layout.max_longitude - windat->layout.min_longitude - step;
+
+	if (!layout_set_scroll(&(windat->layout), windat->layout.scroll + ((direction > 0) ? step : -step)))
+		return;
+
+	/* Slide the range of buttons with icons along, if it has changed.
+	 * Anything newly exposed will be redrawn when the window is
+	 * reopened, so there's no need to keep the damage.
+	 */
+
+	panel_get_materialised_rows(windat, &first, &last);
+
+	if (first != windat->materialised_first || last != windat->materialised_last) {
+		panel_rebuild_window(windat);
+		windat->damaged = FALSE;
+	} else {
+		panel_reopen_window(windat);
+	}
+}
+
+
 /**
  * Handle incoming Message_ModeChange.
  *
@@ -1041,7 +1671,25 @@ static void panel_redraw_handler(wimp_draw *redraw)
 
 static osbool panel_message_mode_change(wimp_message *message)
 {
-	panel_update_mode_details();
+	panel_label_generation++;
+	objutil_invalidate_sprites();
+	panel_schedule_relayout(NULL, PANEL_RELAYOUT_MODE);
+	return TRUE;
+}
+
+
+/**
+ * Handle incoming Message_FontChanged, which will invalidate any button
+ * labels that have been truncated to fit their buttons.
+ *
+ * \param *message		The message data block from the Wimp.
+ */
+
+static osbool panel_message_font_changed(wimp_message *message)
+{
+	panel_label_generation++;
+	panel_set_all_dirty();
+	panel_schedule_relayout(NULL, PANEL_RELAYOUT_POSITIONS);
 	return TRUE;
 }
 
@@ -1061,25 +1709,21 @@ static void panel_update_mode_details(void)
 	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_XWIND_LIMIT, &dimension);
 	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_XEIG_FACTOR, &shift);
 
-	panel_mode_width = ((dimension + 1) << shift);
-	panel_mode_x_units_per_pixel = 1 << shift;
+	panel_screen.mode_width = ((dimension + 1) << shift);
+	panel_screen.x_units_per_pixel = 1 << shift;
 
 	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_YWIND_LIMIT, &dimension);
 	os_read_mode_variable(os_CURRENT_MODE, os_MODEVAR_YEIG_FACTOR, &shift);
 
-	panel_mode_height = ((dimension + 1) << shift);
-	panel_mode_y_units_per_pixel = 1 << shift;
+	panel_screen.mode_height = ((dimension + 1) << shift);
+	panel_screen.y_units_per_pixel = 1 << shift;
 
 	/* Get the iconbar height. */
 
 	state.w = wimp_ICON_BAR;
 	error = xwimp_get_window_state(&state);
 
-	panel_iconbar_height = (error == NULL) ? state.visible.y1 : sf_ICONBAR_HEIGHT;
-
-	/* Update the bars. */
-
-	panel_update_positions();
+	panel_screen.iconbar_height = (error == NULL) ? state.visible.y1 : sf_ICONBAR_HEIGHT;
 }
 
 
@@ -1094,7 +1738,28 @@ static void panel_toggle_window(struct panel_block *windat)
 	if (windat == NULL)
 		return;
 
-	windat->panel_is_open = !windat->panel_is_open;
+	panel_set_open(windat, !windat->panel_is_open);
+}
+
+
+/**
+ * Open or close the button window, and reopen it to reflect the new state.
+ *
+ * \param *windat		The window to be updated.
+ * \param open			TRUE to open the window; FALSE to close it.
+ */
+
+static void panel_set_open(struct panel_block *windat, osbool open)
+{
+	if (windat == NULL)
+		return;
+
+	/* Sprites may have been loaded while the panel was closed. */
+
+	if (open && !windat->panel_is_open)
+		objutil_invalidate_sprites();
+
+	windat->panel_is_open = open;
 
 	panel_reopen_window(windat);
 }
@@ -1109,18 +1774,17 @@ static void panel_toggle_window(struct panel_block *windat)
 
 static void panel_reopen_window(struct panel_block *windat)
 {
-	wimp_window_state	state;
-	os_error		*error;
+	wimp_open	open;
 
 	if (windat == NULL)
 		return;
 
-	state.w = windat->window;
-	error = xwimp_get_window_state(&state);
-	if (error != NULL)
-		return;
+	/* Everything about the open state is calculated from the panel's
+	 * layout, so there's no need to ask the Wimp for the current state.
+	 */
 
-	panel_open_window((wimp_open *) &state);
+	open.w = windat->window;
+	panel_open_window(&open);
 }
 
 /**
@@ -1133,10 +1797,8 @@ static void panel_reopen_window(struct panel_block *windat)
 static void panel_open_window(wimp_open *open)
 {
 	struct panel_block	*windat;
-	int			sidebar_size, grid_size;
-	wimp_icon_state		state;
-	os_error		*error;
-	wimp_window_info	info;
+	struct layout_box	visible;
+	struct layout_coord	scroll;
 
 	if (open == NULL)
 		return;
@@ -1145,74 +1807,15 @@ static void panel_open_window(wimp_open *open)
 	if (windat == NULL)
 		return;
 
-	state.w = windat->window;
-	state.i = PANEL_ICON_SIDEBAR;
-	error = xwimp_get_icon_state(&state);
-	if (error != NULL)
-		return;
-
-	info.w = windat->window;
-	error = xwimp_get_window_info_header_only(&info);
-	if (error != NULL)
-		return;
-
-	grid_size = windat->grid_spacing + (windat->grid_dimensions.x * (windat->grid_spacing + windat->grid_square));
-
-	switch (windat->location) {
-	case PANEL_POSITION_LEFT:
-		sidebar_size = state.icon.extent.x1 - state.icon.extent.x0;
-
-		open->visible.x0 = 0;
-		open->visible.x1 = ((windat->panel_is_open) ? grid_size : 0) + sidebar_size;
-		open->visible.y0 = windat->min_longitude;
-		open->visible.y1 = windat->max_longitude;
-
-		open->xscroll = (windat->panel_is_open) ? 0 : grid_size;
-		open->yscroll = 0;
-		break;
-
-	case PANEL_POSITION_RIGHT:
-		sidebar_size = state.icon.extent.x1 - state.icon.extent.x0;
-
-		open->visible.x0 = panel_mode_width - (((windat->panel_is_open) ? grid_size : 0) + sidebar_size);
-		open->visible.x1 = panel_mode_width;
-		open->visible.y0 = windat->min_longitude;
-		open->visible.y1 = windat->max_longitude;
-
-		open->xscroll = 0;
-		open->yscroll = 0;
-		break;
-
-	case PANEL_POSITION_TOP:
-		sidebar_size = state.icon.extent.y1 - state.icon.extent.y0;
-
-		open->visible.x0 = windat->min_longitude;
-		open->visible.x1 = windat->max_longitude;
-		open->visible.y0 = panel_mode_height - (((windat->panel_is_open) ? grid_size : 0) + sidebar_size);
-		open->visible.y1 = panel_mode_height;
+	layout_get_open_box(&(windat->layout), &panel_screen, windat->panel_is_open, &visible, &scroll);
 
-		open->xscroll = 0;
-		open->yscroll = (windat->panel_is_open) ? 0 : -grid_size;
-		break;
-
-	case PANEL_POSITION_BOTTOM:
-		sidebar_size = state.icon.extent.y1 - state.icon.extent.y0;
-
-		open->visible.x0 = windat->min_longitude;
-		open->visible.x1 = windat->max_longitude;
-		open->visible.y0 = panel_iconbar_height;
-		open->visible.y1 = panel_iconbar_height + (((windat->panel_is_open) ? grid_size : 0) + sidebar_size);
-
-		open->xscroll = 0;
-		open->yscroll = 0;
-		break;
-
-	case PANEL_POSITION_HORIZONTAL:
-	case PANEL_POSITION_VERTICAL:
-	case PANEL_POSITION_NONE:
-		break;
-	}
+	open->visible.x0 = visible.x0;
+	open->visible.y0 = visible.y0;
+	open->visible.x1 = visible.x1;
+	open->visible.y1 = visible.y1;
 
+	open->xscroll = scroll.x;
+	open->yscroll = scroll.y;
 	open->next = (windat->panel_is_open) ? wimp_TOP : wimp_BOTTOM;
 
 	wimp_open_window(open);
@@ -1225,63 +1828,20 @@ static void panel_open_window(wimp_open *open)
 static void panel_update_positions(void)
 {
 	struct panel_block	*windat = NULL;
-	struct panel_block	**panels;
+	struct layout_panel	**panels;
 	size_t			panel_count = 0;
-	os_box			locations, start_pos, next_pos, max_width, units, count;
 	int			i;
 
-	/* Count the number of panels on each side of the screen.*/
-
-	locations.x0 = 0;
-	locations.x1 = 0;
-	locations.y0 = 0;
-	locations.y1 = 0;
-
-	/* Total the number of width units on each side of the screen. */
-
-	units.x0 = 0;
-	units.x1 = 0;
-	units.y0 = 0;
-	units.y1 = 0;
-
 	/* Count through the panels. */
 
 	panel_count = 0;
 
-	windat = panel_list;
-
-	while (windat != NULL) {
-		switch (windat->location) {
-		case PANEL_POSITION_LEFT:
-			locations.x0++;
-			units.x0 += windat->longitude_weight;
-			break;
-		case PANEL_POSITION_RIGHT:
-			locations.x1++;
-			units.x1 += windat->longitude_weight;
-			break;
-		case PANEL_POSITION_TOP:
-			locations.y1++;
-			units.y1 += windat->longitude_weight;
-			break;
-		case PANEL_POSITION_BOTTOM:
-			locations.y0++;
-			units.y0 += windat->longitude_weight;
-			break;
-		case PANEL_POSITION_VERTICAL:
-		case PANEL_POSITION_HORIZONTAL:
-		case PANEL_POSITION_NONE:
-			break;
-		}
-
+	for (windat = panel_list; windat != NULL; windat = windat->next)
 		panel_count++;
 
-		windat = windat->next;
-	}
-
-	/* Create a sorted array of panels. */
+	/* Create an array of panel layouts. */
 
-	panels = heap_alloc(sizeof(struct panel_block *) * panel_count);
+	panels = heap_alloc(sizeof(struct layout_panel *) * panel_count);
 	if (panels == NULL)
 		return;
 
@@ -1289,287 +1849,504 @@ static void panel_update_positions(void)
 	i = 0;
 
 	while ((windat != NULL) && (i < panel_count)) {
-		panels[i++] = windat;
+		panels[i++] = &(windat->layout);
 
 		windat = windat->next;
 	}
 
-	qsort(panels, panel_count, sizeof(struct panel_block *), &compare_panels);
+	/* Update the min and max extent for each bar. */
 
-	/* The lowest position of the first bar on each side of the screen. */
+	layout_arrange_panels(panels, panel_count, &panel_screen);
 
-	start_pos.x0 = panel_iconbar_height;
-	start_pos.x1 = panel_iconbar_height;
-	start_pos.y0 = 0;
-	start_pos.y1 = 0;
+	/* Free the memory allocation. */
 
-	/* The end-to-end distance for all the bars on each side of the screen. */
+	heap_free(panels);
 
-	max_width.x0 = panel_mode_height - panel_iconbar_height;
-	max_width.x1 = panel_mode_height - panel_iconbar_height;
-	max_width.y0 = panel_mode_width;
-	max_width.y1 = panel_mode_width;
+	/* Update the contents of each bar which has changed, then reopen it. */
 
-	/* If there's a bar on the left, push the top and bottom bars in. */
+	for (windat = panel_list; windat != NULL; windat = windat->next)
+		panel_update_layout(windat);
+}
 
-	if (locations.x0 > 0) {
-		start_pos.y0 += panel_sidebar_width;
-		start_pos.y1 += panel_sidebar_width;
 
-		max_width.y0 -= panel_sidebar_width;
-		max_width.y1 -= panel_sidebar_width;
-	}
+/**
+ * Update the layout of a panel, reflowing and rebuilding it only if the
+ * inputs to its geometry or its contents have changed since it was last
+ * rebuilt. The panel's longitudes must already be up to date.
+ *
+ * \param *windat		The panel to be updated.
+ */
 
-	/* If there's a bar on the right, pull the top and bottom bars back. */
+static void panel_update_layout(struct panel_block *windat)
+{
+	osbool geometry_changed;
 
-	if (locations.x1 > 0) {
-		max_width.y0 -= panel_sidebar_width;
-		max_width.y1 -= panel_sidebar_width;
-	}
+	if (windat == NULL)
+		return;
+
+	panel_update_grid_info(windat);
 
-	/* If there's a bar at the bottum, push the left and right bars up. */
+	geometry_changed = (layout_panel_changed(&(windat->layout), &(windat->built_layout)) ||
+			layout_screen_changed(&panel_screen, &(windat->built_screen))) ? TRUE : FALSE;
 
-	if (locations.y0 > 0) {
-		start_pos.x0 += panel_sidebar_height;
-		start_pos.x1 += panel_sidebar_height;
+	/* If nothing has changed, the grid dimensions found by the last
+	 * reflow still apply.
+	 */
 
-		max_width.x0 -= panel_sidebar_height;
-		max_width.x1 -= panel_sidebar_height;
+	if (!windat->dirty && !geometry_changed) {
+		windat->layout.grid_dimensions = windat->built_layout.grid_dimensions;
+		return;
 	}
 
-	/* If there's a bar at the top, pull the left and right bars down. */
+	/* Changes to the buttons invalidate any cached layouts. If the
+	 * panel has been laid out on this screen before, reuse the layout;
+	 * otherwise, work it out and remember it.
+	 */
+
+	if (windat->dirty)
+		panel_flush_mode_cache(windat);
 
-	if (locations.y1 > 0) {
-		max_width.x0 -= panel_sidebar_height;
-		max_width.x1 -= panel_sidebar_height;
+	if (!panel_restore_mode_layout(windat)) {
+		panel_reflow_buttons(windat);
+		layout_set_extent(&(windat->layout), &panel_screen);
+		panel_store_mode_layout(windat);
 	}
 
-	/* Track the start of the next bar on each side of the screen. */
+	panel_update_window_extent(windat);
+	panel_rebuild_window(windat);
 
-	next_pos.x0 = start_pos.x0;
-	next_pos.x1 = start_pos.x1;
-	next_pos.y0 = start_pos.y0;
-	next_pos.y1 = start_pos.y1;
+	/* If the panel's geometry has changed, the whole window needs to be
+	 * redrawn; otherwise, just redraw the buttons which have changed.
+	 */
 
-	/* Count the number of width weight units seen so far. */
+	if (geometry_changed) {
+		windat->damaged = FALSE;
+		windows_redraw(windat->window);
+	} else {
+		panel_flush_damage(windat);
+	}
 
-	count.x0 = 0;
-	count.x1 = 0;
-	count.y0 = 0;
-	count.y1 = 0;
+	windat->built_layout = windat->layout;
+	windat->built_screen = panel_screen;
+	windat->dirty = FALSE;
+}
 
-	/* Update the min and max extent for each bar, then reopen it. */
 
-	for (i = 0; i < panel_count; i++) {
-		switch (panels[i]->location) {
-		case PANEL_POSITION_LEFT:
-			count.x0 += panels[i]->longitude_weight;
-			panels[i]->min_longitude = next_pos.x0;
+/**
+ * Mark all of the panels as needing to be rebuilt.
+ */
 
-			panels[i]->max_longitude = ((count.x0 * max_width.x0) / units.x0) + start_pos.x0;
-			next_pos.x0 = panels[i]->max_longitude + panel_mode_y_units_per_pixel;
-			break;
-		case PANEL_POSITION_RIGHT:
-			count.x1 += panels[i]->longitude_weight;
-			panels[i]->min_longitude = next_pos.x1;
+static void panel_set_all_dirty(void)
+{
+	struct panel_block *windat;
 
-			panels[i]->max_longitude = ((count.x1 * max_width.x1) / units.x1) + start_pos.x1;
-			next_pos.x1 = panels[i]->max_longitude + panel_mode_y_units_per_pixel;
-			break;
-		case PANEL_POSITION_TOP:
-			count.y1 += panels[i]->longitude_weight;
-			panels[i]->min_longitude = next_pos.y1;
+	for (windat = panel_list; windat != NULL; windat = windat->next)
+		windat->dirty = TRUE;
+}
 
-			panels[i]->max_longitude = ((count.y1 * max_width.y1) / units.y1) + start_pos.y1;
-			next_pos.y1 = panels[i]->max_longitude + panel_mode_x_units_per_pixel;
-			break;
-		case PANEL_POSITION_BOTTOM:
-			count.y0 += panels[i]->longitude_weight;
-			panels[i]->min_longitude = next_pos.y0;
 
-			panels[i]->max_longitude = ((count.y0 * max_width.y0) / units.y0) + start_pos.y0;
-			next_pos.y0 = panels[i]->max_longitude + panel_mode_x_units_per_pixel;
-			break;
-		case PANEL_POSITION_VERTICAL:
-		case PANEL_POSITION_HORIZONTAL:
-		case PANEL_POSITION_NONE:
-			break;
-		}
+/**
+ * Request that some layout work is carried out on the next null poll, so
+ * that several changes arriving together only result in one update.
+ *
+ * \param *windat		The panel to be relaid out, or NULL.
+ * \param action		The layout work which is required.
+ */
+
+static void panel_schedule_relayout(struct panel_block *windat, enum panel_relayout action)
+{
+	if (windat != NULL)
+		windat->relayout = TRUE;
+
+	panel_relayout_pending |= action;
+}
+
+
+/**
+ * Find out whether the panels have any work to do on null polls, and if
+ * so when it is next due.
+ *
+ * \param *time			Pointer to a variable to take the time at
+ *				which a null event is required.
+ * \return			TRUE if a null event is required; else FALSE.
+ */
 
-		panel_update_grid_info(panels[i]);
-		panel_reflow_buttons(panels[i]);
-		panel_update_window_extent(panels[i]);
-		panel_rebuild_window(panels[i]);
-		panel_reopen_window(panels[i]);
+osbool panel_get_idle_time(os_t *time)
+{
+	os_t hover;
+
+	if (time == NULL)
+		return FALSE;
+
+	/* Deferred layout work is done as soon as possible. */
+
+	if (panel_relayout_pending != PANEL_RELAYOUT_NONE) {
+		*time = os_read_monotonic_time();
+		return TRUE;
 	}
 
-	/* Free the memory allocation. */
+	/* Dropped objects are added once the rest of their drag has had
+	 * time to arrive.
+	 */
 
-	heap_free(panels);
+	if (panel_drops_waiting) {
+		*time = panel_drop_time;
+		return TRUE;
+	}
+
+	/* Otherwise, launch targets are checked if there are any panels. */
+
+	if (panel_list == NULL)
+		return FALSE;
+
+	*time = panel_revalidate_time;
+
+	/* If the pointer is over a panel, it is watched to see which button
+	 * it comes to rest on.
+	 */
+
+	if (panel_hover_panel != NULL && panel_prefetch_delay > 0) {
+		hover = os_read_monotonic_time() + PANEL_HOVER_INTERVAL;
+
+		if ((int) (hover - *time) < 0)
+			*time = hover;
+	}
+
+	return TRUE;
 }
 
 
 /**
- * Compare two entries in an array of pointers to panel instances.
- * Used as a callback function for qsort().
- *
- * \param *p			Pointer to the first array entry.
- * \param *q			Pointer to the second array entry.
- * \return			-1, 0 or +1 depending on sort order.
+ * Carry out any work which is due on a null poll. This should be called
+ * from the poll loop on null events.
  */
 
-static int compare_panels(const void *p, const void *q)
+void panel_process_idle(void)
 {
-	const struct panel_block * const *a = p;
-	const struct panel_block * const *b = q;
+	struct panel_block	*windat;
+	os_t			now, start;
 
-	if (a == NULL || *a == NULL || b == NULL || *b == NULL)
-		return 0;
+	now = os_read_monotonic_time();
+
+	/* Add any dropped objects before the layout is brought up to date,
+	 * so that each drag results in a single reflow.
+	 */
+
+	if (panel_drops_waiting && (int) (now - panel_drop_time) >= 0) {
+		panel_drops_waiting = FALSE;
+
+		for (windat = panel_list; windat != NULL; windat = windat->next)
+			panel_add_dropped_buttons(windat);
+	}
+
+	panel_process_relayout();
+
+	now = os_read_monotonic_time();
+
+	panel_track_hover(now);
+
+	if (panel_reach_generation != reach_get_generation())
+		panel_update_reachability();
+
+	if ((int) (now - panel_revalidate_time) < 0)
+		return;
+
+	/* Check as many targets as will fit into the budget. If some are
+	 * still due when it runs out, carry on at the next null poll.
+	 */
+
+	start = now;
+
+	while (panel_revalidate_target(now)) {
+		now = os_read_monotonic_time();
 
-	return ((*a)->sort > (*b)->sort) - ((*a)->sort < (*b)->sort);
+		if ((int) (now - start) >= panel_validate_budget) {
+			panel_revalidate_time = now;
+			return;
+		}
+	}
+
+	panel_revalidate_time = now + PANEL_REVALIDATE_INTERVAL;
 }
 
 
 /**
- * Update the button window grid details to take into account new values from
- * the configuration.
- *
- * \param *windat		The window to be updated.
-  */
+ * Carry out any deferred layout work.
+ */
 
-static void panel_update_grid_info(struct panel_block *windat)
+static void panel_process_relayout(void)
 {
-	struct paneldb_entry panel;
+	struct panel_block	*windat;
+	enum panel_relayout	action = panel_relayout_pending;
 
-	if (windat == NULL)
+	if (action == PANEL_RELAYOUT_NONE)
 		return;
 
-	if (paneldb_get_panel_info(windat->panel_id, &panel) == NULL)
+	panel_relayout_pending = PANEL_RELAYOUT_NONE;
+
+	if (action & PANEL_RELAYOUT_MODE)
+		panel_update_mode_details();
+
+	if (action & (PANEL_RELAYOUT_MODE | PANEL_RELAYOUT_POSITIONS)) {
+		for (windat = panel_list; windat != NULL; windat = windat->next)
+			windat->relayout = FALSE;
+
+		panel_update_positions();
 		return;
+	}
 
-	/* Update the user choices. */
+	for (windat = panel_list; windat != NULL; windat = windat->next) {
+		if (!windat->relayout)
+			continue;
 
-	windat->grid_square = config_int_read("GridSize");
-	windat->grid_spacing = config_int_read("GridSpacing");
-	windat->grid_depth = panel.depth;
-	windat->slab_grid_dimensions.x = panel.slab_size.x;
-	windat->slab_grid_dimensions.y = panel.slab_size.y;
+		windat->relayout = FALSE;
+		panel_update_layout(windat);
+	}
+}
 
-	/* Update the slab size in OS units. */
 
-	windat->slab_os_dimensions.x = (windat->slab_grid_dimensions.x * (windat->grid_spacing + windat->grid_square))
-			- windat->grid_spacing;
-	windat->slab_os_dimensions.y = (windat->slab_grid_dimensions.y * (windat->grid_spacing + windat->grid_square))
-			- windat->grid_spacing;
+/**
+ * Check the launch target of the next button which is due, so that clicks
+ * can be acted on from the cached details and buttons whose targets have
+ * gone missing can be shaded. The buttons are checked in turn, carrying on
+ * from where the previous call left off, so that a pass over all of the
+ * panels only visits each button once; only one target is examined on
+ * each call, to limit the time taken away from other tasks if the filing
+ * systems involved are slow.
+ *
+ * \param now			The current time.
+ * \return			TRUE if a button was due to be checked;
+ *				FALSE if there was nothing to do.
+ */
+
+static osbool panel_revalidate_target(os_t now)
+{
+	struct panel_block	*windat;
+	struct icondb_button	*button;
+	struct appdb_entry	app;
+	enum reach_state	state;
+	osbool			invalid;
+	int			wraps = 0;
 
-	/* Calculate the number of rows in the panel at the current slab size. */
+	windat = panel_revalidate_panel;
+	button = panel_revalidate_button;
 
-	windat->grid_dimensions.x = windat->grid_depth;
+	/* Look for the next button which is due, going round to the first
+	 * panel after the last. Going round twice means that every button
+	 * has been seen, and none is due.
+	 */
 
-	if (windat->grid_square + windat->grid_spacing != 0)
-		windat->grid_dimensions.y = (windat->max_longitude - windat->min_longitude) /
-				(windat->grid_square + windat->grid_spacing);
-	else
-		windat->grid_dimensions.y = 0;
+	while (button == NULL || (button->target.checked != 0 &&
+			(int) (now - button->target.checked) < PANEL_REVALIDATE_AGE)) {
+		if (button != NULL) {
+			button = button->next;
+			continue;
+		}
+
+		windat = (windat == NULL) ? NULL : windat->next;
+
+		if (windat == NULL) {
+			windat = panel_list;
+
+			if (windat == NULL || ++wraps > 1) {
+				panel_revalidate_panel = NULL;
+				panel_revalidate_button = NULL;
+				return FALSE;
+			}
+		}
+
+		button = icondb_get_list(windat->icondb);
+	}
+
+	/* The next call carries on from the following button. */
+
+	panel_revalidate_panel = windat;
+	panel_revalidate_button = button->next;
+
+	if (appdb_get_button_info(button->key, &app) == NULL) {
+		button->target.checked = now;
+		return TRUE;
+	}
+
+	/* Don't touch targets on discs which haven't responded to a probe,
+	 * as this would block until their filing systems time out.
+	 */
+
+	state = reach_get_state(app.command);
+
+	panel_set_unreachable(windat, button, (state == REACH_STATE_UNREACHABLE) ? TRUE : FALSE);
+
+	if (state != REACH_STATE_REACHABLE) {
+		button->target.checked = now;
+		return TRUE;
+	}
+
+	/* If the target has appeared or gone missing, redraw the button. */
+
+	invalid = (button->target.type == OBJUTIL_TARGET_INVALID) ? TRUE : FALSE;
+
+	if (objutil_refresh_target(app.command, &(button->target)) &&
+			invalid != (button->target.type == OBJUTIL_TARGET_INVALID))
+		panel_redraw_button(windat, button);
+
+	return TRUE;
+}
+
+
+/**
+ * Update the shading of all of the buttons in the panels, following a
+ * change in the reachability of the discs holding their targets.
+ */
+
+static void panel_update_reachability(void)
+{
+	struct panel_block	*windat;
+	struct icondb_button	*button;
+	struct appdb_entry	app;
+	enum reach_state	state;
+
+	panel_reach_generation = reach_get_generation();
+
+	for (windat = panel_list; windat != NULL; windat = windat->next) {
+		for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+			if (appdb_get_button_info(button->key, &app) == NULL)
+				continue;
+
+			state = reach_get_state(app.command);
+
+			panel_set_unreachable(windat, button, (state == REACH_STATE_UNREACHABLE) ? TRUE : FALSE);
+		}
+	}
 }
 
+
 /**
- * Update the vertical position of the buttons window to take into account
- * a change of screen mode.
+ * Track the button under the pointer while it is over a panel. Once the
+ * pointer has rested on a button for the prefetch delay, the button's
+ * target is examined so that it can be launched without delay if the
+ * button is then clicked.
  *
- * \param *windat		The window to be reopened.
+ * \param now			The current time.
  */
 
-static void panel_update_window_extent(struct panel_block *windat)
+static void panel_track_hover(os_t now)
 {
-	int			new_window_size;
-	wimp_window_info	info;
-	os_error		*error;
+	wimp_pointer		pointer;
+	struct icondb_button	*button = NULL;
+	struct appdb_entry	app;
+	unsigned		key;
 
-	if (windat == NULL)
+	if (panel_hover_panel == NULL || panel_prefetch_delay <= 0)
 		return;
 
-	info.w = windat->window;
-	error = xwimp_get_window_info_header_only(&info);
-	if (error != NULL)
+	if (xwimp_get_pointer_info(&pointer) != NULL)
 		return;
 
-	/* Update the window extent. */
+	if (pointer.w == panel_hover_panel->window)
+		button = panel_find_button(panel_hover_panel, &pointer);
 
-	new_window_size = windat->max_longitude - windat->min_longitude;
+	key = (button != NULL) ? button->key : APPDB_NULL_KEY;
 
-	if (windat->location & PANEL_POSITION_VERTICAL) {
+	/* If the pointer has moved to another button, start timing again. */
 
-		/* Calculate the new vertical size of the window. */
+	if (key != panel_hover_key) {
+		panel_hover_key = key;
+		panel_hover_time = now;
+		panel_hover_prefetched = FALSE;
+		return;
+	}
 
-		info.extent.y1 = 0;
-		info.extent.y0 = info.extent.y1 - new_window_size;
+	if (button == NULL || button->unreachable || panel_hover_prefetched || (int) (now - panel_hover_time) < panel_prefetch_delay)
+		return;
 
-		/* Calculate the new horizontal size of the window. */
+	panel_hover_prefetched = TRUE;
 
-		info.extent.x0 = 0;
-		info.extent.x1 = info.extent.x0 + panel_sidebar_width + windat->grid_spacing +
-				windat->grid_dimensions.x * (windat->grid_spacing + windat->grid_square);
-	} else if (windat->location & PANEL_POSITION_HORIZONTAL) {
+	if (appdb_get_button_info(key, &app) != NULL)
+		objutil_prefetch_target(app.command, &(button->target));
+}
 
-		/* Calculate the new horizontal size of the window. */
 
-		info.extent.x0 = 0;
-		info.extent.x1 = info.extent.x0 + new_window_size;
+/**
+ * Return the number of button presses whose targets had, and had not, been
+ * prefetched by the pointer resting over the button beforehand.
+ *
+ * \param *hits			Pointer to a variable to take the number
+ *				of presses whose targets were prefetched.
+ * \param *misses		Pointer to a variable to take the number
+ *				of presses whose targets were not.
+ */
 
-		/* Calculate the new vertical size of the window. */
+void panel_get_prefetch_counts(unsigned *hits, unsigned *misses)
+{
+	if (hits != NULL)
+		*hits = panel_prefetch_hits;
 
-		info.extent.y1 = 0;
-		info.extent.y0 = info.extent.y1 - panel_sidebar_height - windat->grid_spacing -
-				windat->grid_dimensions.x * (windat->grid_spacing + windat->grid_square);
-	}
+	if (misses != NULL)
+		*misses = panel_prefetch_misses;
+}
 
-	/* Update the extent. */
 
-	error = xwimp_set_extent(windat->window, &(info.extent));
-	if (error != NULL)
+/**
+ * Update the button window grid details to take into account new values from
+ * the configuration.
+ *
+ * \param *windat		The window to be updated.
+  */
+
+static void panel_update_grid_info(struct panel_block *windat)
+{
+	struct paneldb_entry	panel;
+	struct layout_coord	slab_size;
+
+	if (windat == NULL)
 		return;
 
-	/* Move the sidebar icon into its new location. */
+	if (paneldb_get_panel_info(windat->panel_id, &panel) == NULL)
+		return;
 
-	switch (windat->location) {
-	case PANEL_POSITION_LEFT:
-		windat->origin.x = info.extent.x1 - windat->grid_spacing - panel_sidebar_width;
-		windat->origin.y = info.extent.y1 - windat->grid_spacing;
+	/* Update the user choices. */
 
-		xwimp_resize_icon(windat->window, PANEL_ICON_SIDEBAR,
-			info.extent.x1 - panel_sidebar_width, info.extent.y0, info.extent.x1, info.extent.y1);
-		break;
+	slab_size.x = panel.slab_size.x;
+	slab_size.y = panel.slab_size.y;
 
-	case PANEL_POSITION_RIGHT:
-		windat->origin.x = info.extent.x0 + windat->grid_spacing + panel_sidebar_width;
-		windat->origin.y = info.extent.y1 - windat->grid_spacing;
+	layout_set_grid(&(windat->layout), config_int_read("GridSize"), config_int_read("GridSpacing"),
+			panel.depth, &slab_size);
 
-		xwimp_resize_icon(windat->window, PANEL_ICON_SIDEBAR,
-			info.extent.x0, info.extent.y0, info.extent.x0 + panel_sidebar_width, info.extent.y1);
-		break;
+	windat->layout.scrolling = panel_scroll_enabled;
+}
 
-	case PANEL_POSITION_TOP:
-		windat->origin.x = info.extent.x0 + windat->grid_spacing;
-		windat->origin.y = info.extent.y0 + windat->grid_spacing + panel_sidebar_height;
+/**
+ * Apply the extent and sidebar location calculated for a panel to its
+ * window.
+ *
+ * \param *windat		The window to be updated.
+ */
 
-		xwimp_resize_icon(windat->window, PANEL_ICON_SIDEBAR,
-			info.extent.x0, info.extent.y0, info.extent.x1, info.extent.y0 + panel_sidebar_height);
-		break;
+static void panel_update_window_extent(struct panel_block *windat)
+{
+	struct layout_box	*sidebar;
+	os_box			extent;
+	os_error		*error;
 
-	case PANEL_POSITION_BOTTOM:
-		windat->origin.x = info.extent.x0 + windat->grid_spacing;
-		windat->origin.y = info.extent.y1 - windat->grid_spacing - panel_sidebar_height;
+	if (windat == NULL)
+		return;
 
-		xwimp_resize_icon(windat->window, PANEL_ICON_SIDEBAR,
-			info.extent.x0, info.extent.y1 - panel_sidebar_height, info.extent.x1, info.extent.y1);
-		break;
+	/* Update the extent. */
 
-	case PANEL_POSITION_HORIZONTAL:
-	case PANEL_POSITION_VERTICAL:
-	case PANEL_POSITION_NONE:
-		break;
-	}
+	extent.x0 = windat->layout.extent.x0;
+	extent.y0 = windat->layout.extent.y0;
+	extent.x1 = windat->layout.extent.x1;
+	extent.y1 = windat->layout.extent.y1;
+
+	error = xwimp_set_extent(windat->window, &extent);
+	if (error != NULL)
+		return;
+
+	/* Move the sidebar icon into its new location. */
+
+	sidebar = &(windat->layout.sidebar);
+
+	xwimp_resize_icon(windat->window, PANEL_ICON_SIDEBAR, sidebar->x0, sidebar->y0, sidebar->x1, sidebar->y1);
 }
 
 
@@ -1604,8 +2381,7 @@ void panel_create_from_db(void)
 		panel_add_buttons_from_db(windat);
 	} while (key != PANELDB_NULL_KEY);
 
-
-	panel_update_positions();
+	panel_schedule_relayout(NULL, PANEL_RELAYOUT_POSITIONS);
 }
 
 /**
@@ -1619,11 +2395,25 @@ static void panel_add_buttons_from_db(struct panel_block *windat)
 {
 	unsigned		key, panel;
 	struct appdb_entry	app;
+	struct icondb_button	*button = NULL, *next = NULL;
+
+	if (windat == NULL)
+		return;
+
+	/* Mark all of the existing buttons as stale, so that any which
+	 * are no longer in the panel can be identified later.
+	 */
 
-	panel_empty_window(windat);
-	icondb_reset_instance(windat->icondb);
+	button = icondb_get_list(windat->icondb);
+
+	while (button != NULL) {
+		button->stale = TRUE;
+		button = button->next;
+	}
 
-	/* Add the icons to the database one by one. */
+	/* Add the icons to the database one by one, reusing any existing
+	 * entries so that their Wimp icons can be retained.
+	 */
 
 	key = APPDB_NULL_KEY;
 
@@ -1641,299 +2431,1237 @@ static void panel_add_buttons_from_db(struct panel_block *windat)
 			if (appdb_get_button_info(key, &app) == NULL)
 				continue;
 
-			icondb_create_icon(windat->icondb, key, &(app.position));
+			button = icondb_find_key(windat->icondb, key);
+
+			if (button == NULL) {
+				button = icondb_create_icon(windat->icondb, key, &(app.position));
+				if (button != NULL)
+					button->running = (launch_get_running_task(key) != 0) ? TRUE : FALSE;
+
+				windat->dirty = TRUE;
+				continue;
+			}
+
+			if (!panel_auto_arrange && (button->ideal.x != app.position.x || button->ideal.y != app.position.y)) {
+				icondb_move_icon(windat->icondb, button, &(app.position));
+				windat->dirty = TRUE;
+			}
+
+			button->stale = FALSE;
 		}
 	} while (key != APPDB_NULL_KEY);
+
+	/* Remove any buttons which were not found, along with their icons. */
+
+	button = icondb_get_list(windat->icondb);
+
+	while (button != NULL) {
+		next = button->next;
+
+		if (button->stale) {
+			if (panel_revalidate_button == button)
+				panel_revalidate_button = next;
+
+			panel_delete_icon(windat, button);
+			icondb_delete_icon(windat->icondb, button);
+			windat->dirty = TRUE;
+		}
+
+		button = next;
+	}
+
+	if (panel_auto_arrange)
+		panel_arrange_buttons(windat);
 }
 
 
 /**
- * Reflow the buttons in a panel, to reflect the available space
- * on the grid.
- * 
- * \param *windat		The panel to be reflowed.
+ * Arrange the buttons in a panel by how often they have been used, packing
+ * the most used nearest to the edge of the screen. Buttons which have been
+ * used equally often keep the order of their positions in the database.
+ *
+ * \param *windat		The panel to arrange.
  */
 
-static void panel_reflow_buttons(struct panel_block *windat)
+static void panel_arrange_buttons(struct panel_block *windat)
 {
-	struct icondb_button	*button = NULL, *previous = NULL;
-	struct appdb_entry	*app = NULL;
-	os_coord		overflow;
-	osbool			clash;
-	
-	if (windat == NULL)
+	struct paneldb_entry		panel;
+	struct appdb_entry		app;
+	struct panel_arrangement	*arrangement;
+	struct icondb_button		*button;
+	os_coord			position;
+	int				count = 0, columns, rows, pitch, i;
+
+	if (windat == NULL || paneldb_get_panel_info(windat->panel_id, &panel) == NULL)
 		return;
 
-	/* Start the grid at the configured width. */
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next)
+		count++;
 
-	windat->grid_dimensions.x = windat->grid_depth;
+	if (count == 0)
+		return;
 
-	/* Start to place overflow buttons top-left. */
+	/* If there's no memory for the arrangement, leave the buttons
+	 * where they were.
+	 */
 
-	overflow.x = 0;
-	overflow.y = 0;
+	arrangement = heap_alloc(count * sizeof(struct panel_arrangement));
+	if (arrangement == NULL)
+		return;
 
-	/* Process the icons. */
+	count = 0;
 
-	button = icondb_get_list(windat->icondb);
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+		if (appdb_get_button_info(button->key, &app) == NULL)
+			continue;
 
-	while (button != NULL) {
-		app = appdb_get_button_info(button->key, NULL);
-		if (app != NULL) {
-			button->position.x = app->position.x;
-			button->position.y = app->position.y;
+		arrangement[count].button = button;
+		arrangement[count].launches = appdb_get_launch_count(button->key);
+		arrangement[count].position = app.position;
+		count++;
+	}
 
-			/* Do a bounds check on all the buttons above and to the left. */
+	qsort(arrangement, count, sizeof(struct panel_arrangement), panel_compare_arrangements);
 
-			previous = icondb_get_list(windat->icondb);
+	/* Fill the grid a slab at a time, along the length of the panel and
+	 * then across its depth. The last column is the one against the edge
+	 * of the screen, so it is filled first. If the panel's length isn't
+	 * known yet, or it can't hold all of the buttons, share them equally
+	 * between the columns. Moving a button relinks the icon list, but
+	 * the arrangement holds its own pointers.
+	 */
 
-			while (previous != NULL && previous != button) {
-				if ((button->position.x > previous->position.x) &&
-						(button->position.x < (previous->position.x + windat->slab_grid_dimensions.x)) &&
-						(button->position.y >= previous->position.y) &&
-						(button->position.y < (previous->position.y + windat->slab_grid_dimensions.y))) {
-					button->position.x = previous->position.x + windat->slab_grid_dimensions.x;
-				}
+	columns = (panel.slab_size.x > 0) ? panel.depth / panel.slab_size.x : 0;
+	if (columns < 1)
+		columns = 1;
 
-				if ((button->position.y >= previous->position.y) &&
-						(button->position.y < (previous->position.y + windat->slab_grid_dimensions.y)) &&
-						(button->position.x > (previous->position.x - windat->slab_grid_dimensions.x)) &&
-						(button->position.x <= previous->position.x)) {
-					button->position.y = previous->position.y + windat->slab_grid_dimensions.y;
-				}
+	pitch = windat->layout.grid_square + windat->layout.grid_spacing;
 
-				previous = previous->next;
-			}
+	rows = (pitch > 0 && panel.slab_size.y > 0) ?
+			(windat->layout.max_longitude - windat->layout.min_longitude) / (pitch * panel.slab_size.y) : 0;
 
-			/* Does the button fall outside the configured rows?
-			 *
-			 * We know by now that we've reached the bottom of the grid in all
-			 * columns, due to the sort order, so we're just looking for spaces
-			 * in the layout working right in columns from top to bottom.
-			 */
-
-			if ((button->position.y + windat->slab_grid_dimensions.y) > windat->grid_dimensions.y) {
-				do {
-					clash = FALSE;
-
-					previous = icondb_get_list(windat->icondb);
-
-					while (previous != NULL && previous != button) {
-						if ((overflow.x > (previous->position.x - windat->slab_grid_dimensions.x)) &&
-								(overflow.x < (previous->position.x + windat->slab_grid_dimensions.x)) &&
-								(overflow.y > (previous->position.y - windat->slab_grid_dimensions.y)) &&
-								(overflow.y < (previous->position.y + windat->slab_grid_dimensions.y)))
-							clash = TRUE;	
-
-						previous = previous->next;
-					}
-
-					if (clash) {
-						overflow.y++;
-
-						if ((overflow.y + windat->slab_grid_dimensions.y) > windat->grid_dimensions.y) {
-							overflow.x++;
-							overflow.y = 0;
-						}
-					}
-				} while (clash);
-	
-				button->position.x = overflow.x;
-				button->position.y = overflow.y;
-			}
+	if (rows * columns < count)
+		rows = (count + columns - 1) / columns;
 
-			/* Does the button fall outside the colfigured columns? */
+	for (i = 0; i < count; i++) {
+		position.x = (columns - 1 - (i / rows)) * panel.slab_size.x;
+		position.y = (i % rows) * panel.slab_size.y;
 
-			if ((button->position.x + windat->slab_grid_dimensions.x) > windat->grid_dimensions.x)
-				windat->grid_dimensions.x = button->position.x + windat->slab_grid_dimensions.x;
-		}
+		button = arrangement[i].button;
 
-		button = button->next;
+		if (button->ideal.x != position.x || button->ideal.y != position.y) {
+			icondb_move_icon(windat->icondb, button, &position);
+			windat->dirty = TRUE;
+		}
 	}
+
+	heap_free(arrangement);
+}
+
+
+/**
+ * Compare two button arrangements, so that the most used buttons sort
+ * first, followed by the rest in database position order.
+ *
+ * \param *p			The first arrangement to compare.
+ * \param *q			The second arrangement to compare.
+ * \return			The result of the comparison.
+ */
+
+static int panel_compare_arrangements(const void *p, const void *q)
+{
+	const struct panel_arrangement *a = p, *b = q;
+
+	if (a->launches != b->launches)
+		return (a->launches > b->launches) ? -1 : 1;
+
+	if (a->position.y != b->position.y)
+		return a->position.y - b->position.y;
+
+	return a->position.x - b->position.x;
+}
+
+
+/**
+ * Reflow the buttons in a panel, to reflect the available space
+ * on the grid.
+ * 
+ * \param *windat		The panel to be reflowed.
+ */
+
+static void panel_reflow_buttons(struct panel_block *windat)
+{
+	struct icondb_button	*button;
+	struct layout_button	*buttons;
+	size_t			count = 0, i;
+
+	if (windat == NULL)
+		return;
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next)
+		count++;
+
+	/* If there's no memory to reflow into, leave each button at the
+	 * position that it asked for.
+	 */
+
+	buttons = heap_alloc(((count > 0) ? count : 1) * sizeof(struct layout_button));
+	if (buttons == NULL) {
+		for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next)
+			button->position = button->ideal;
+
+		return;
+	}
+
+	i = 0;
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+		buttons[i].ideal.x = button->ideal.x;
+		buttons[i].ideal.y = button->ideal.y;
+		i++;
+	}
+
+	layout_reflow_buttons(&(windat->layout), buttons, count);
+
+	i = 0;
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+		button->position.x = buttons[i].position.x;
+		button->position.y = buttons[i].position.y;
+		i++;
+	}
+
+	heap_free(buttons);
 }
 
+/**
+ * Restore the layout of a panel from its cache, if it has previously been
+ * laid out on the current screen with the same buttons and choices. The
+ * panel's grid information must already be up to date.
+ *
+ * \param *windat		The panel to restore.
+ * \return			TRUE if the layout was restored; else FALSE.
+ */
+
+static osbool panel_restore_mode_layout(struct panel_block *windat)
+{
+	struct panel_mode_layout	*entry, *parent = NULL;
+	struct icondb_button		*button;
+	int				i;
+
+	if (windat == NULL)
+		return FALSE;
+
+	for (entry = windat->mode_cache; entry != NULL; entry = entry->next) {
+		if (!layout_screen_changed(&(entry->screen), &panel_screen) &&
+				!layout_panel_changed(&(entry->layout), &(windat->layout)))
+			break;
+
+		parent = entry;
+	}
+
+	if (entry == NULL)
+		return FALSE;
+
+	/* Check that the buttons are the ones that the layout was made for. */
+
+	button = icondb_get_list(windat->icondb);
+
+	for (i = 0; i < entry->count && button != NULL; i++) {
+		if (button->key != entry->positions[i].key)
+			return FALSE;
+
+		button = button->next;
+	}
+
+	if (i != entry->count || button != NULL)
+		return FALSE;
+
+	/* Restore the calculated parts of the layout. */
+
+	windat->layout.grid_dimensions = entry->layout.grid_dimensions;
+	windat->layout.origin = entry->layout.origin;
+	windat->layout.extent = entry->layout.extent;
+	windat->layout.sidebar = entry->layout.sidebar;
+	windat->layout.transform = entry->layout.transform;
+
+	layout_set_scroll(&(windat->layout), windat->layout.scroll);
+
+	button = icondb_get_list(windat->icondb);
+
+	for (i = 0; i < entry->count; i++) {
+		button->position = entry->positions[i].position;
+		button = button->next;
+	}
+
+	/* Move the entry to the head of the cache. */
+
+	if (parent != NULL) {
+		parent->next = entry->next;
+		entry->next = windat->mode_cache;
+		windat->mode_cache = entry;
+	}
+
+	return TRUE;
+}
+
+
+/**
+ * Store the current layout of a panel in its cache, against the current
+ * screen details, discarding the least recently used entry if the cache
+ * is full.
+ *
+ * \param *windat		The panel to store.
+ */
+
+static void panel_store_mode_layout(struct panel_block *windat)
+{
+	struct panel_mode_layout	*entry, *parent = NULL;
+	struct icondb_button		*button;
+	int				i, count = 0;
+
+	if (windat == NULL)
+		return;
+
+	/* Drop the oldest entry if the cache is full. */
+
+	for (entry = windat->mode_cache; entry != NULL && entry->next != NULL; entry = entry->next) {
+		parent = entry;
+		count++;
+	}
+
+	if (entry != NULL && count + 1 >= PANEL_MODE_CACHE_SIZE) {
+		if (parent != NULL)
+			parent->next = NULL;
+		else
+			windat->mode_cache = NULL;
+
+		if (entry->positions != NULL)
+			heap_free(entry->positions);
+		heap_free(entry);
+	}
+
+	/* Create the new entry. */
+
+	count = 0;
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next)
+		count++;
+
+	entry = heap_alloc(sizeof(struct panel_mode_layout));
+	if (entry == NULL)
+		return;
+
+	entry->positions = NULL;
+
+	if (count > 0) {
+		entry->positions = heap_alloc(count * sizeof(struct panel_mode_position));
+		if (entry->positions == NULL) {
+			heap_free(entry);
+			return;
+		}
+	}
+
+	entry->screen = panel_screen;
+	entry->layout = windat->layout;
+	entry->count = count;
+
+	button = icondb_get_list(windat->icondb);
+
+	for (i = 0; i < count; i++) {
+		entry->positions[i].key = button->key;
+		entry->positions[i].position = button->position;
+		button = button->next;
+	}
+
+	entry->next = windat->mode_cache;
+	windat->mode_cache = entry;
+}
+
+
+/**
+ * Discard all of the cached layouts for a panel.
+ *
+ * \param *windat		The panel to flush.
+ */
+
+static void panel_flush_mode_cache(struct panel_block *windat)
+{
+	struct panel_mode_layout *entry;
+
+	if (windat == NULL)
+		return;
+
+	while (windat->mode_cache != NULL) {
+		entry = windat->mode_cache;
+		windat->mode_cache = entry->next;
+
+		if (entry->positions != NULL)
+			heap_free(entry->positions);
+		heap_free(entry);
+	}
+}
+
+
 /**
  * Rebuild the contents of a panel. This should be done after updating the
- * panel's extent, so that icon origins are correct.
+ * panel's extent, so that icon origins are correct. Only icons whose extents
+ * have changed are touched.
  *
  * \param *windat		The window to be rebuilt.
  */
 
 static void panel_rebuild_window(struct panel_block *windat)
 {
-	struct icondb_button *button = NULL;
-	
+	struct icondb_button	*button = NULL;
+	int			first, last;
+
 	if (windat == NULL)
 		return;
 
+	/* Only buttons on rows in or near the visible area get icons. */
+
+	panel_get_materialised_rows(windat, &first, &last);
+
 	button = icondb_get_list(windat->icondb);
 
 	while (button != NULL) {
-		panel_create_icon(windat, button);
+		if ((button->position.y + windat->layout.slab_grid_dimensions.y) > first && button->position.y <= last)
+			panel_create_icon(windat, button);
+		else
+			panel_release_button(windat, button);
 
 		button = button->next;
 	}
 
+	windat->materialised_first = first;
+	windat->materialised_last = last;
+
 	panel_reopen_window(windat);
+}
+
+
+/**
+ * Find the range of grid rows in a panel whose buttons should have icons.
+ * For a scrolling panel, this is the visible area plus a margin; for other
+ * panels, it is every row.
+ *
+ * \param *windat		The panel to find the rows for.
+ * \param *first		Pointer to a variable to take the first row.
+ * \param *last			Pointer to a variable to take the last row.
+ */
+
+static void panel_get_materialised_rows(struct panel_block *windat, int *first, int *last)
+{
+	*first = 0;
+	*last = INT_MAX;
+
+	if (windat == NULL || !windat->layout.scrolling)
+		return;
+
+	if (!layout_get_visible_rows(&(windat->layout), PANEL_SCROLL_MARGIN, first, last)) {
+		*first = 0;
+		*last = -1;
+	}
+}
+
+
+/**
+ * Release the icon and label of a button which has scrolled out of range
+ * of the visible area of a panel.
+ *
+ * \param *windat		The panel containing the button.
+ * \param *button		The button to be released.
+ */
+
+static void panel_release_button(struct panel_block *windat, struct icondb_button *button)
+{
+	if (windat == NULL || button == NULL)
+		return;
+
+	panel_delete_icon(windat, button);
+
+	if (button->text != NULL) {
+		heap_free(button->text);
+		button->text = NULL;
+	}
+
+	if (button->text_name != NULL) {
+		heap_free(button->text_name);
+		button->text_name = NULL;
+	}
+}
+
+/**
+ * Remove the Wimp icon associated with a button, if one exists.
+ *
+ * \param *windat		The panel containing the button.
+ * \param *button		The button whose icon is to be removed.
+ */
+
+static void panel_delete_icon(struct panel_block *windat, struct icondb_button *button)
+{
+	os_error		*error = NULL;
+
+	if (windat == NULL || button == NULL)
+		return;
+
+	windat->display_valid = FALSE;
+
+	if (button->icon == wimp_ICON_WINDOW)
+		return;
+
+	panel_add_damage(windat, &(button->extent));
+
+	error = xwimp_delete_icon(windat->window, button->icon);
+	if (error != NULL)
+		error_report_program(error);
+
+	button->icon = wimp_ICON_WINDOW;
+}
+
+/**
+ * Create an icon for a button, based on that icon's definition block. If
+ * the button already has an icon, it is left alone if its extent has not
+ * changed, or moved using Wimp_ResizeIcon if it has.
+ *
+ * \param *windat		The window to create the icon in.
+ * \param *button		The definition to create an icon for.
+ */
+
+static void panel_create_icon(struct panel_block *windat, struct icondb_button *button)
+{
+	os_error		*error = NULL;
+	struct appdb_entry	*app = NULL;
+	osbool			show_name;
+	os_box			extent;
+	char			name[APPDB_NAME_LENGTH];
+
+	if (windat == NULL || button == NULL)
+		return;
+
+	/* Take a copy of the details that we need, as *app is a pointer into
+	 * the flex heap and will not survive any memory allocation below.
+	 */
+
+	app = appdb_get_button_info(button->key, NULL);
+	if (app == NULL)
+		return;
+
+	show_name = app->show_name;
+	if (show_name)
+		string_copy(name, app->name, APPDB_NAME_LENGTH);
+
+	app = NULL;
+
+	windat->display_valid = FALSE;
+
+	/* Position the icon extent. */
+
+	panel_get_button_extent(windat, button, &extent);
+
+	/* Set up the inset bounds. */
+
+	button->inset.x0 = extent.x0 + PANEL_INSET_OFFSET;
+	button->inset.y0 = extent.y0 + PANEL_INSET_OFFSET;
+	button->inset.x1 = extent.x1 - PANEL_INSET_OFFSET;
+	button->inset.y1 = extent.y1 - PANEL_INSET_OFFSET;
+
+	/* Set up the icon text. */
+
+	if (show_name && panel_update_label(button, name, button->inset.x1 - button->inset.x0))
+		panel_add_damage(windat, &extent);
+
+	/* In icon-less mode, the button is just an area of the work area. */
+
+	if (panel_iconless) {
+		panel_delete_icon(windat, button);
+
+		if (button->window != windat->window || extent.x0 != button->extent.x0 || extent.y0 != button->extent.y0 ||
+				extent.x1 != button->extent.x1 || extent.y1 != button->extent.y1) {
+			panel_add_damage(windat, &(button->extent));
+			panel_add_damage(windat, &extent);
+		}
+
+		button->window = windat->window;
+		button->extent = extent;
+		return;
+	}
+
+	/* If the icon already exists, move it only if its extent has changed. */
+
+	if (button->icon != wimp_ICON_WINDOW && button->window == windat->window) {
+		if (extent.x0 != button->extent.x0 || extent.y0 != button->extent.y0 ||
+				extent.x1 != button->extent.x1 || extent.y1 != button->extent.y1) {
+			error = xwimp_resize_icon(windat->window, button->icon, extent.x0, extent.y0, extent.x1, extent.y1);
+			if (error != NULL)
+				error_report_program(error);
+
+			panel_add_damage(windat, &(button->extent));
+			panel_add_damage(windat, &extent);
+
+			button->extent = extent;
+		}
+
+		return;
+	}
+
+	/* Store the icon details. */
+
+	panel_icon_base_def.w = windat->window;
+	panel_icon_base_def.icon.extent = extent;
+
+	button->window = windat->window;
+	button->extent = extent;
+	button->icon = wimp_create_icon(&panel_icon_base_def);
+
+	panel_add_damage(windat, &extent);
+}
+
+
+/**
+ * Find the extent of a button's icon within its panel's work area, from
+ * the button's current grid position.
+ *
+ * \param *windat		The panel containing the button.
+ * \param *button		The button to find the extent of.
+ * \param *extent		Pointer to a box to take the icon extent.
+ */
+
+static void panel_get_button_extent(struct panel_block *windat, struct icondb_button *button, os_box *extent)
+{
+	struct layout_coord	position;
+	struct layout_box	box;
+
+	if (windat == NULL || button == NULL || extent == NULL)
+		return;
+
+	position.x = button->position.x;
+	position.y = button->position.y;
+
+	layout_get_button_extent(&(windat->layout), &position, &box);
+
+	extent->x0 = box.x0;
+	extent->y0 = box.y0;
+	extent->x1 = box.x1;
+	extent->y1 = box.y1;
+}
+
+
+/**
+ * Add a rectangle to the area of a panel which needs to be redrawn after
+ * the buttons have been updated.
+ *
+ * \param *windat		The panel to update.
+ * \param *box			The work area rectangle to be added.
+ */
+
+static void panel_add_damage(struct panel_block *windat, os_box *box)
+{
+	if (windat == NULL || box == NULL || box->x1 <= box->x0 || box->y1 <= box->y0)
+		return;
+
+	if (!windat->damaged) {
+		windat->damage = *box;
+		windat->damaged = TRUE;
+		return;
+	}
+
+	if (box->x0 < windat->damage.x0)
+		windat->damage.x0 = box->x0;
+	if (box->y0 < windat->damage.y0)
+		windat->damage.y0 = box->y0;
+	if (box->x1 > windat->damage.x1)
+		windat->damage.x1 = box->x1;
+	if (box->y1 > windat->damage.y1)
+		windat->damage.y1 = box->y1;
+}
+
+
+/**
+ * Force a redraw of the area of a panel which has been affected by changes
+ * to its buttons, and reset the area.
+ *
+ * \param *windat		The panel to redraw.
+ */
+
+static void panel_flush_damage(struct panel_block *windat)
+{
+	os_error *error;
+
+	if (windat == NULL || !windat->damaged)
+		return;
+
+	windat->damaged = FALSE;
+
+	error = xwimp_force_redraw(windat->window, windat->damage.x0, windat->damage.y0,
+			windat->damage.x1, windat->damage.y1);
+	if (error != NULL)
+		error_report_program(error);
+}
+
+
+/**
+ * Update the truncated label text for a button, reusing the existing text
+ * if it was created from the same name, at the same width, and since the
+ * last change of desktop font or mode.
+ *
+ * \param *button		The button to update the label for.
+ * \param *name		The full name of the button.
+ * \param width		The available width, in OS units.
+ * \return			TRUE if the label text was changed; else FALSE.
+ */
+
+static osbool panel_update_label(struct icondb_button *button, char *name, int width)
+{
+	os_error	*error = NULL;
+	char		text[APPDB_NAME_LENGTH];
+	osbool		changed;
+
+	if (button == NULL || name == NULL)
+		return FALSE;
+
+	if (button->text != NULL && button->text_name != NULL && button->text_width == width &&
+			button->text_generation == panel_label_generation && strcmp(button->text_name, name) == 0)
+		return FALSE;
+
+	error = xwimptextop_truncate_with_ellipsis(name, text, APPDB_NAME_LENGTH, width, NULL);
+
+	/* At least copy the text across if the available Wimp doesn't
+	 * support Wimp_TextOp 4.
+	 */
+
+	if (error != NULL)
+		string_copy(text, name, APPDB_NAME_LENGTH);
+
+	changed = (button->text == NULL || strcmp(button->text, text) != 0) ? TRUE : FALSE;
+
+	if (button->text != NULL)
+		heap_free(button->text);
+
+	if (button->text_name != NULL)
+		heap_free(button->text_name);
+
+	button->text = heap_strdup(text);
+	button->text_name = heap_strdup(name);
+	button->text_width = width;
+	button->text_generation = panel_label_generation;
+
+	return changed;
+}
+
+
+/**
+ * Build the display list for a panel, so that redraws can plot the inset
+ * icons without needing to refer to the application database or the
+ * sprite pool.
+ *
+ * \param *windat		The panel to build the display list for.
+ */
+
+static void panel_build_display_list(struct panel_block *windat)
+{
+	int			count = 0, row, i, first, last;
+	char			*sprite, name[APPDB_NAME_LENGTH];
+	os_box			extent;
+	struct icondb_button	*button;
+	struct appdb_entry	*app;
+	struct panel_plot	*plot;
+
+	if (windat == NULL)
+		return;
+
+	if (windat->display != NULL)
+		heap_free(windat->display);
+
+	if (windat->display_rows != NULL)
+		heap_free(windat->display_rows);
+
+	windat->display = NULL;
+	windat->display_count = 0;
+	windat->display_rows = NULL;
+	windat->display_row_count = 0;
+	windat->display_valid = FALSE;
+	windat->backing_valid = FALSE;
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next)
+		count++;
+
+	if (count == 0) {
+		windat->display_valid = TRUE;
+		windat->display_sprite_generation = objutil_get_sprite_generation();
+		return;
+	}
+
+	windat->display = heap_alloc(count * sizeof(struct panel_plot));
+	if (windat->display == NULL)
+		return;
+
+	panel_get_materialised_rows(windat, &first, &last);
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+		app = appdb_get_button_info(button->key, NULL);
+		if (app == NULL)
+			continue;
+
+		/* A button on a row which has come into range since the panel
+		 * was last rebuilt will have had its label released, and its
+		 * inset may be out of date. Make them again now, so that the
+		 * row doesn't appear without its names. The name must be
+		 * copied out of the flex heap before the label is allocated.
+		 */
+
+		if (app->show_name && button->text == NULL &&
+				(button->position.y + windat->layout.slab_grid_dimensions.y) > first && button->position.y <= last) {
+			string_copy(name, app->name, APPDB_NAME_LENGTH);
+
+			panel_get_button_extent(windat, button, &extent);
+
+			button->inset.x0 = extent.x0 + PANEL_INSET_OFFSET;
+			button->inset.y0 = extent.y0 + PANEL_INSET_OFFSET;
+			button->inset.x1 = extent.x1 - PANEL_INSET_OFFSET;
+			button->inset.y1 = extent.y1 - PANEL_INSET_OFFSET;
+
+			panel_update_label(button, name, button->inset.x1 - button->inset.x0);
+
+			app = appdb_get_button_info(button->key, NULL);
+			if (app == NULL)
+				continue;
+		}
+
+		/* Find a sprite that's in the pool; the cache lookup can
+		 * allocate memory, so do this before getting a pointer into
+		 * the flex heap for the rest of the button details.
+		 */
+
+		sprite = objutil_resolve_sprite(app->sprite, "file_xxx");
+
+		app = appdb_get_button_info(button->key, NULL);
+		if (app == NULL || sprite == NULL)
+			continue;
+
+		plot = windat->display + windat->display_count++;
+
+		/* If a button has no label, such as when there wasn't enough
+		 * memory to make one, show its full name instead. The name
+		 * is pointed to once the list has been sorted.
+		 */
+
+		if (app->show_name) {
+			plot->icon = panel_icon_text_def;
+			plot->validation[0] = 'S';
+			string_copy(plot->validation + 1, sprite, PANEL_MAX_VALIDATION_LEN - 1);
+
+			if (button->text != NULL) {
+				plot->icon.data.indirected_text_and_sprite.text = button->text;
+			} else {
+				string_copy(plot->name, app->name, APPDB_NAME_LENGTH);
+				plot->icon.data.indirected_text_and_sprite.text = NULL;
+			}
+
+			plot->icon.data.indirected_text_and_sprite.size =
+					strlen((button->text != NULL) ? button->text : plot->name) + 1;
+		} else {
+			plot->icon = panel_icon_sprite_def;
+			plot->icon.data.indirected_sprite.id = (osspriteop_id) sprite;
+			plot->icon.data.indirected_sprite.size = strlen(sprite) + 1;
+		}
+
+		plot->icon.extent = button->inset;
+
+		if (button->pressed)
+			plot->icon.flags |= wimp_ICON_SELECTED;
+
+		if (button->unreachable || button->target.type == OBJUTIL_TARGET_INVALID)
+			plot->icon.flags |= wimp_ICON_SHADED;
+
+		plot->running = button->running;
+
+		plot->row = button->position.y;
+		plot->key = button->key;
+	}
+
+	/* Sort the list into row order, then point the text icons at their
+	 * validation strings and any copied names, now that the entries
+	 * won't move again.
+	 */
+
+	qsort(windat->display, windat->display_count, sizeof(struct panel_plot), panel_compare_plots);
+
+	for (i = 0; i < windat->display_count; i++) {
+		plot = windat->display + i;
+
+		if (!(plot->icon.flags & wimp_ICON_TEXT))
+			continue;
+
+		plot->icon.data.indirected_text_and_sprite.validation = plot->validation;
+
+		if (plot->icon.data.indirected_text_and_sprite.text == NULL)
+			plot->icon.data.indirected_text_and_sprite.text = plot->name;
+	}
+
+	/* Index the first entry on each row. If there isn't enough memory
+	 * for the index, redraws will just scan the whole list.
+	 */
+
+	if (windat->display_count > 0) {
+		windat->display_row_count = windat->display[windat->display_count - 1].row + 1;
+		windat->display_rows = heap_alloc((windat->display_row_count + 1) * sizeof(int));
+	}
+
+	if (windat->display_rows != NULL) {
+		i = 0;
+
+		for (row = 0; row <= windat->display_row_count; row++) {
+			while (i < windat->display_count && windat->display[i].row < row)
+				i++;
+
+			windat->display_rows[row] = i;
+		}
+	} else {
+		windat->display_row_count = 0;
+	}
+
+	windat->display_valid = TRUE;
+	windat->display_sprite_generation = objutil_get_sprite_generation();
+}
+
+
+/**
+ * Compare two display list entries for sorting into row order.
+ *
+ * \param *p		Pointer to the first entry to compare.
+ * \param *q		Pointer to the second entry to compare.
+ * \return		The result of the comparison.
+ */
+
+static int panel_compare_plots(const void *p, const void *q)
+{
+	const struct panel_plot *a = p;
+	const struct panel_plot *b = q;
+
+	if (a == NULL || b == NULL)
+		return 0;
+
+	return (a->row > b->row) - (a->row < b->row);
+}
+
+
+/**
+ * Render a panel's display list into a backing store sprite, if backing
+ * stores are enabled. If the sprite would exceed the memory limit, or
+ * can't be created, the panel falls back to plotting the display list
+ * directly.
+ *
+ * \param *windat		The panel to build the backing store for.
+ */
+
+static void panel_build_backing_store(struct panel_block *windat)
+{
+	int			i;
+	os_box			extent;
+	wimp_icon		icon;
+	struct panel_plot	*plot;
+
+	if (windat == NULL)
+		return;
+
+	backing_destroy(windat->backing);
+	windat->backing = NULL;
+	windat->backing_valid = TRUE;
+
+	if (!panel_backing_enabled || windat->display_count == 0)
+		return;
+
+	/* Find the area covered by the buttons, including their base slabs.
+	 * The sprite is plotted over the whole area, so it must hold the
+	 * slabs as well as the insets.
+	 */
+
+	extent = windat->display[0].icon.extent;
+
+	for (i = 1; i < windat->display_count; i++) {
+		plot = windat->display + i;
+
+		if (plot->icon.extent.x0 < extent.x0)
+			extent.x0 = plot->icon.extent.x0;
+		if (plot->icon.extent.y0 < extent.y0)
+			extent.y0 = plot->icon.extent.y0;
+		if (plot->icon.extent.x1 > extent.x1)
+			extent.x1 = plot->icon.extent.x1;
+		if (plot->icon.extent.y1 > extent.y1)
+			extent.y1 = plot->icon.extent.y1;
+	}
+
+	extent.x0 -= PANEL_INSET_OFFSET;
+	extent.y0 -= PANEL_INSET_OFFSET;
+	extent.x1 += PANEL_INSET_OFFSET;
+	extent.y1 += PANEL_INSET_OFFSET;
+
+	windat->backing = backing_create(&extent, panel_backing_limit);
+	if (windat->backing == NULL)
+		return;
+
+	/* Plot the icons into the sprite, relative to its bottom-left corner. */
+
+	backing_get_extent(windat->backing, &extent);
+
+	if (!backing_start_output(windat->backing, panel_window_def->work_bg)) {
+		backing_destroy(windat->backing);
+		windat->backing = NULL;
+		return;
+	}
+
+	for (i = 0; i < windat->display_count; i++) {
+		panel_plot_base(&(windat->display[i].icon.extent), -extent.x0, -extent.y0);
+
+		icon = windat->display[i].icon;
+
+		icon.extent.x0 -= extent.x0;
+		icon.extent.y0 -= extent.y0;
+		icon.extent.x1 -= extent.x0;
+		icon.extent.y1 -= extent.y0;
+
+		wimp_plot_icon(&icon);
+
+		if (windat->display[i].running)
+			panel_plot_running_marker(&(windat->display[i].icon.extent), -extent.x0, -extent.y0);
+	}
+
+	backing_end_output(windat->backing);
+}
+
+
+/**
+ * Press a button in the window.
+ *
+ * \param *windat		The window containing the button.
+ * \param *button		The button being pressed, or NULL.
+ * \param time			The time at which the button was clicked.
+ */
+
+static void panel_press(struct panel_block *windat, struct icondb_button *button, os_t time)
+{
+	struct appdb_entry	app;
+
+	if (windat == NULL || button == NULL)
+		return;
+
+	if (appdb_get_button_info(button->key, &app) == NULL)
+		return;
+
+	/* If the button's task is already running, bring it to the front
+	 * if required; if it has no icon bar icon, launch it again.
+	 */
+
+	if (panel_switch_to_running && launch_raise_task(launch_get_running_task(button->key)))
+		return;
+
+	if (button->key == panel_hover_key && panel_hover_prefetched)
+		panel_prefetch_hits++;
+	else
+		panel_prefetch_misses++;
+
+	/* Queue the launch, and show the button pressed until it is done. */
+
+	if (launch_queue(app.command, &(button->target), button->key, time, panel_launch_callback))
+		panel_set_pressed(windat, button, TRUE);
+}
+
+
+/**
+ * Callback to handle changes in the state of a button's launch request.
+ *
+ * \param key			The key of the button being launched.
+ * \param state			The new state of the launch.
+ * \param *target		The details of the object, as launched.
+ */
+
+static void panel_launch_callback(unsigned key, enum launch_state state, struct objutil_target *target)
+{
+	struct panel_block	*windat;
+	struct icondb_button	*button = NULL;
+
+	/* Count the launch in the button's usage statistics as soon as its
+	 * command has been run, whether or not a new task is seen to start.
+	 * Each request is either dispatched or completed, but not both.
+	 */
+
+	if (state == LAUNCH_STATE_DISPATCHED || state == LAUNCH_STATE_COMPLETE)
+		appdb_record_launch(key);
+
+	/* The button may have been deleted since it was pressed. */
+
+	for (windat = panel_list; windat != NULL; windat = windat->next) {
+		button = icondb_find_key(windat->icondb, key);
+		if (button != NULL)
+			break;
+	}
+
+	if (windat == NULL || button == NULL)
+		return;
+
+	/* Keep the details found by the launch, so that the next click
+	 * doesn't have to look at the object again.
+	 */
+
+	if (target != NULL)
+		button->target = *target;
+
+	/* Mark the button while any task that it started is running. */
+
+	if (state == LAUNCH_STATE_STARTED || state == LAUNCH_STATE_CLOSED)
+		panel_set_running(windat, button, (launch_get_running_task(key) != 0) ? TRUE : FALSE);
 
-	windows_redraw(windat->window);
+	panel_set_pressed(windat, button, (state == LAUNCH_STATE_QUEUED || state == LAUNCH_STATE_DISPATCHED) ? TRUE : FALSE);
 }
 
+
 /**
- * Remove the buttons from within a panel.
- * 
- * \param *windat		The panel to be emptied.
+ * Set the pressed state of a button, redrawing it if it changes.
+ *
+ * \param *windat		The panel containing the button.
+ * \param *button		The button to update.
+ * \param pressed		TRUE to show the button pressed; else FALSE.
  */
 
-static void panel_empty_window(struct panel_block *windat)
+static void panel_set_pressed(struct panel_block *windat, struct icondb_button *button, osbool pressed)
 {
-	struct icondb_button	*button = NULL;
-	os_error		*error = NULL;
-	
-	if (windat == NULL)
+	if (windat == NULL || button == NULL || button->pressed == pressed)
 		return;
 
-	button = icondb_get_list(windat->icondb);
-
-	while (button != NULL) {
-		if (button->icon != wimp_ICON_WINDOW) {
-			error = xwimp_delete_icon(windat->window, button->icon);
-			if (error != NULL)
-				error_report_program(error);
-		}
+	button->pressed = pressed;
 
-		button = button->next;
-	}
+	panel_redraw_button(windat, button);
 }
 
+
 /**
- * Create (or recreate) an icon for a button, based on that icon's definition
- * block.
+ * Set the unreachable state of a button, redrawing it if it changes.
  *
- * \param *windat		The window to create the icon in.
- * \param *button		The definition to create an icon for.
+ * \param *windat		The panel containing the button.
+ * \param *button		The button to update.
+ * \param unreachable		TRUE to show the button shaded; else FALSE.
  */
 
-static void panel_create_icon(struct panel_block *windat, struct icondb_button *button)
+static void panel_set_unreachable(struct panel_block *windat, struct icondb_button *button, osbool unreachable)
 {
-	os_error		*error = NULL;
-	struct appdb_entry	*app = NULL;
-	int			width;
-	char			text[APPDB_NAME_LENGTH];
-
-	if (windat == NULL || button == NULL)
+	if (windat == NULL || button == NULL || button->unreachable == unreachable)
 		return;
 
-	if (button->icon != -1) {
-		error = xwimp_delete_icon(windat->window, button->icon);
-		if (error != NULL)
-			error_report_program(error);
-		button->icon = -1;
-	}
+	button->unreachable = unreachable;
 
-	app = appdb_get_button_info(button->key, NULL);
-	if (app == NULL)
-		return;
+	panel_redraw_button(windat, button);
+}
 
-	panel_icon_base_def.w = windat->window;
 
-	/* Position the icon extent. */
+/**
+ * Set the running state of a button, redrawing it if it changes.
+ *
+ * \param *windat		The panel containing the button.
+ * \param *button		The button to update.
+ * \param running		TRUE to mark the button as running; else FALSE.
+ */
 
-	switch (windat->location) {
-	case PANEL_POSITION_LEFT:
-		panel_icon_base_def.icon.extent.x1 = windat->origin.x - button->position.x * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.y1 = windat->origin.y - button->position.y * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.x0 = panel_icon_base_def.icon.extent.x1 - windat->slab_os_dimensions.x;
-		panel_icon_base_def.icon.extent.y0 = panel_icon_base_def.icon.extent.y1 - windat->slab_os_dimensions.y;
-		break;
+static void panel_set_running(struct panel_block *windat, struct icondb_button *button, osbool running)
+{
+	if (windat == NULL || button == NULL || button->running == running)
+		return;
 
-	case PANEL_POSITION_RIGHT:
-		panel_icon_base_def.icon.extent.x0 = windat->origin.x + button->position.x * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.y1 = windat->origin.y - button->position.y * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.x1 = panel_icon_base_def.icon.extent.x0 + windat->slab_os_dimensions.x;
-		panel_icon_base_def.icon.extent.y0 = panel_icon_base_def.icon.extent.y1 - windat->slab_os_dimensions.y;
-		break;
+	button->running = running;
 
-	case PANEL_POSITION_TOP:
-		panel_icon_base_def.icon.extent.x0 = windat->origin.x + button->position.y * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.y0 = windat->origin.y + button->position.x * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.x1 = panel_icon_base_def.icon.extent.x0 + windat->slab_os_dimensions.y;
-		panel_icon_base_def.icon.extent.y1 = panel_icon_base_def.icon.extent.y0 + windat->slab_os_dimensions.x;
-		break;
+	panel_redraw_button(windat, button);
+}
 
-	case PANEL_POSITION_BOTTOM:
-		panel_icon_base_def.icon.extent.x0 = windat->origin.x + button->position.y * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.y1 = windat->origin.y - button->position.x * (windat->grid_square + windat->grid_spacing);
-		panel_icon_base_def.icon.extent.x1 = panel_icon_base_def.icon.extent.x0 + windat->slab_os_dimensions.y;
-		panel_icon_base_def.icon.extent.y0 = panel_icon_base_def.icon.extent.y1 - windat->slab_os_dimensions.x;
-		break;
 
-	case PANEL_POSITION_HORIZONTAL:
-	case PANEL_POSITION_VERTICAL:
-	case PANEL_POSITION_NONE:
-		break;
-	}
+/**
+ * Redraw a single button following a change to its state, without
+ * rebuilding the rest of the panel.
+ *
+ * \param *windat		The panel containing the button.
+ * \param *button		The button to redraw.
+ */
 
-	/* Set up the inset bounds. */
+static void panel_redraw_button(struct panel_block *windat, struct icondb_button *button)
+{
+	os_box extent;
 
-	button->inset.x0 = panel_icon_base_def.icon.extent.x0 + PANEL_INSET_OFFSET;
-	button->inset.y0 = panel_icon_base_def.icon.extent.y0 + PANEL_INSET_OFFSET;
-	button->inset.x1 = panel_icon_base_def.icon.extent.x1 - PANEL_INSET_OFFSET;
-	button->inset.y1 = panel_icon_base_def.icon.extent.y1 - PANEL_INSET_OFFSET;
+	if (windat == NULL || button == NULL)
+		return;
 
-	/* Set up the icon text. */
+	windat->display_valid = FALSE;
 
-	if (app->show_name) {
-		width = button->inset.x1 - button->inset.x0;
-		error = xwimptextop_truncate_with_ellipsis(app->name, text, APPDB_NAME_LENGTH, width, NULL);
+	panel_get_button_extent(windat, button, &extent);
 
-		/* At least copy the text across if the available Wimp doesn't
-		 * support Wimp_TextOp 4.
-		 */
+	panel_add_damage(windat, &extent);
+	panel_flush_damage(windat);
+}
 
-		if (error != NULL)
-			string_copy(text, app->name, APPDB_NAME_LENGTH);
+/**
+ * Find the button under the pointer in a panel. If the buttons have Wimp
+ * icons, the Wimp's icon handle is used; otherwise, the pointer position
+ * is looked up in the rows of the panel's display list.
+ *
+ * \param *windat		The panel to search.
+ * \param *pointer		The pointer details to look up.
+ * \return			The button under the pointer, or NULL.
+ */
 
-		/*** WARNING: The heap_strdup() will invalidate *app, ***
-		 *** as it will shift the flex heap around.           ***
-		 ***/
+static struct icondb_button *panel_find_button(struct panel_block *windat, wimp_pointer *pointer)
+{
+	wimp_window_state	window;
+	struct layout_box	area;
+	int			i, start, end, first, last;
+	struct panel_plot	*plot;
 
-		button->text = heap_strdup(text);
-	}
+	if (windat == NULL || pointer == NULL || pointer->i == PANEL_ICON_SIDEBAR)
+		return NULL;
 
-	/* Store the icon details. */
+	if (pointer->i != wimp_ICON_WINDOW)
+		return icondb_find_icon(windat->icondb, pointer->w, pointer->i);
 
-	button->window = windat->window;
-	button->icon = wimp_create_icon(&panel_icon_base_def);
-}
+	if (!panel_iconless)
+		return NULL;
 
+	/* Find the pointer position in work area coordinates. */
 
-/**
- * Press a button in the window.
- *
- * \param *windat		The window containing the icon.
- * \param icon			The handle of the icon being pressed.
- */
+	window.w = windat->window;
+	if (xwimp_get_window_state(&window) != NULL)
+		return NULL;
 
-static void panel_press(struct panel_block *windat, wimp_i icon)
-{
-	struct appdb_entry	app;
-	struct icondb_button	*button = NULL;
+	area.x0 = (pointer->pos.x - window.visible.x0) + window.xscroll;
+	area.y0 = (pointer->pos.y - window.visible.y1) + window.yscroll;
+	area.x1 = area.x0 + 1;
+	area.y1 = area.y0 + 1;
 
-	if (windat == NULL)
-		return;
+	/* Search the rows of the display list which could contain it. */
 
-	button = icondb_find_icon(windat->icondb, windat->window, icon);
+	if (!windat->display_valid || windat->display_sprite_generation != objutil_get_sprite_generation())
+		panel_build_display_list(windat);
 
-	if (button == NULL)
-		return;
+	if (windat->display_rows == NULL) {
+		start = 0;
+		end = windat->display_count;
+	} else if (layout_get_row_range(&(windat->layout), &area, &first, &last) &&
+			first < windat->display_row_count) {
+		if (last >= windat->display_row_count)
+			last = windat->display_row_count - 1;
 
-	if (appdb_get_button_info(button->key, &app) == NULL)
-		return;
+		start = windat->display_rows[first];
+		end = windat->display_rows[last + 1];
+	} else {
+		return NULL;
+	}
 
-	objutil_launch(app.command);
+	for (i = start; i < end; i++) {
+		plot = windat->display + i;
+
+		if (area.x0 >= plot->icon.extent.x0 - PANEL_INSET_OFFSET && area.x0 < plot->icon.extent.x1 + PANEL_INSET_OFFSET &&
+				area.y0 >= plot->icon.extent.y0 - PANEL_INSET_OFFSET && area.y0 < plot->icon.extent.y1 + PANEL_INSET_OFFSET)
+			return icondb_find_key(windat->icondb, plot->key);
+	}
 
-	return;
+	return NULL;
 }
 
 /*
@@ -2106,7 +3834,7 @@ static osbool panel_process_button_dialogue(struct appdb_entry *app, void *data)
 
 	/* Validate the button location. */
 
-	if (app->position.x < 0 || app->position.y < 0 || app->position.x >= windat->grid_depth || app->position.y >= windat->grid_dimensions.y) {
+	if (app->position.x < 0 || app->position.y < 0 || app->position.x >= windat->layout.grid_depth || app->position.y >= windat->layout.grid_dimensions.y) {
 		error_msgs_report_info("CoordRange");
 		return FALSE;
 	}
@@ -2136,10 +3864,19 @@ static osbool panel_process_button_dialogue(struct appdb_entry *app, void *data)
 
 	appdb_set_button_info(key, app);
 
+	/* The button's sprite or text may have changed without it moving,
+	 * and its command may now refer to a different object.
+	 */
+
+	if (button != NULL) {
+		panel_add_damage(windat, &(button->extent));
+		objutil_clear_target(&(button->target));
+	}
+
+	windat->dirty = TRUE;
+
 	panel_add_buttons_from_db(windat);
-	panel_reflow_buttons(windat);
-	panel_update_window_extent(windat);
-	panel_rebuild_window(windat);
+	panel_schedule_relayout(windat, PANEL_RELAYOUT_PANELS);
 
 	return TRUE;
 }
@@ -2161,16 +3898,378 @@ static osbool panel_delete_button(struct panel_block *windat, struct icondb_butt
 	if (config_opt_read("ConfirmDelete") && (error_msgs_report_question("QDelete", "QDeleteB") != 3))
 		return FALSE;
 
+	latency_forget(button->key);
 	appdb_delete_key(button->key);
 
 	panel_add_buttons_from_db(windat);
-	panel_reflow_buttons(windat);
-	panel_update_window_extent(windat);
-	panel_rebuild_window(windat);
+	panel_schedule_relayout(windat, PANEL_RELAYOUT_PANELS);
+
+	return TRUE;
+}
+
+
+/**
+ * Handle incoming Message_DataLoad, by queueing objects dropped on to a
+ * panel so that they can be added as buttons. A multi-object drag from the
+ * Filer arrives as a series of messages, so nothing is added until the
+ * messages stop arriving.
+ *
+ * \param *message		The message data to be handled.
+ * \return			TRUE to claim the message; FALSE to pass it on.
+ */
+
+static osbool panel_message_data_load(wimp_message *message)
+{
+	wimp_full_message_data_xfer	*data_load = (wimp_full_message_data_xfer *) message;
+	struct panel_block		*windat;
+	struct panel_drop		*drop, **list;
+	wimp_window_state		window;
+	struct layout_coord		point, cell;
+
+	if (message == NULL)
+		return FALSE;
+
+	windat = panel_list;
+
+	while (windat != NULL && windat->window != data_load->w)
+		windat = windat->next;
+
+	if (windat == NULL)
+		return FALSE;
+
+	drop = heap_alloc(sizeof(struct panel_drop));
+	if (drop != NULL) {
+		drop->object = heap_strdup(data_load->file_name);
+
+		if (drop->object == NULL) {
+			heap_free(drop);
+			drop = NULL;
+		}
+	}
+
+	if (drop == NULL) {
+		error_msgs_report_error("NoMemNewButton");
+		return TRUE;
+	}
+
+	drop->next = NULL;
+
+	/* The objects in a drag are placed around the cell on to which the
+	 * first of them was dropped.
+	 */
+
+	if (windat->drops == NULL) {
+		windat->drop_cell.x = 0;
+		windat->drop_cell.y = 0;
+
+		window.w = windat->window;
+
+		if (xwimp_get_window_state(&window) == NULL) {
+			point.x = (data_load->pos.x - window.visible.x0) + window.xscroll;
+			point.y = (data_load->pos.y - window.visible.y1) + window.yscroll;
+
+			layout_get_grid_cell(&(windat->layout), &point, &cell);
+
+			windat->drop_cell.x = cell.x;
+			windat->drop_cell.y = cell.y;
+		}
+	}
+
+	list = &(windat->drops);
+
+	while (*list != NULL)
+		list = &((*list)->next);
+
+	*list = drop;
+
+	panel_drops_waiting = TRUE;
+	panel_drop_time = os_read_monotonic_time() + PANEL_DROP_DELAY;
+
+	/* Acknowledge the load, so that the sender knows that it worked. */
+
+	message->your_ref = message->my_ref;
+	message->action = message_DATA_LOAD_ACK;
+	wimp_send_message(wimp_USER_MESSAGE, message, message->sender);
 
 	return TRUE;
 }
 
+
+/**
+ * Add the objects waiting to be dropped on to a panel as new buttons. The
+ * sprites for all of the objects are found in a single batch, then each is
+ * given the nearest free cell to the drop point before all of the buttons
+ * are added to the database together, with a single reflow of the panel.
+ *
+ * \param *windat		The panel to add the buttons to.
+ */
+
+static void panel_add_dropped_buttons(struct panel_block *windat)
+{
+	struct panel_drop		*drop;
+	struct appdb_entry		*entries = NULL, *entry;
+	struct objutil_sprite_request	*requests = NULL;
+	struct icondb_button		*button;
+	unsigned			*keys = NULL;
+	char				*occupied = NULL, skipped[PANEL_DROP_COUNT_LEN];
+	os_coord			slab;
+	int				count = 0, added = 0, failed = 0, depth, rows, i;
+
+	if (windat == NULL || windat->drops == NULL)
+		return;
+
+	for (drop = windat->drops; drop != NULL; drop = drop->next)
+		count++;
+
+	slab.x = windat->layout.slab_grid_dimensions.x;
+	slab.y = windat->layout.slab_grid_dimensions.y;
+	depth = windat->layout.grid_depth;
+
+	if (slab.x < 1)
+		slab.x = 1;
+
+	if (slab.y < 1)
+		slab.y = 1;
+
+	/* If a button is wider than the panel, none of the objects can be
+	 * given a cell.
+	 */
+
+	if (depth < slab.x) {
+		error_msgs_report_error("DropNoRoom");
+		panel_discard_drops(windat);
+		return;
+	}
+
+	/* The new buttons are placed around the existing buttons' positions
+	 * in the database, rather than where the last reflow put them, so
+	 * the map must cover the furthest of these. Allow enough rows beyond
+	 * that for every object to find a cell; the reflow will deal with
+	 * any which don't fit.
+	 */
+
+	rows = windat->layout.grid_dimensions.y;
+
+	for (button = icondb_get_list(windat->icondb); button != NULL; button = button->next) {
+		if (button->ideal.y + slab.y > rows)
+			rows = button->ideal.y + slab.y;
+	}
+
+	rows += count * slab.y;
+
+	if (rows > 0) {
+		entries = heap_alloc(count * sizeof(struct appdb_entry));
+		requests = heap_alloc(count * sizeof(struct objutil_sprite_request));
+		keys = heap_alloc(count * sizeof(unsigned));
+		occupied = heap_alloc(depth * rows);
+	}
+
+	if (entries == NULL || requests == NULL || keys == NULL || occupied == NULL) {
+		error_msgs_report_error("NoMemNewButton");
+		count = 0;
+	} else {
+		memset(occupied, 0, depth * rows);
+	}
+
+	for (button = icondb_get_list(windat->icondb); count > 0 && button != NULL; button = button->next)
+		panel_fill_cells(occupied, depth, rows, &slab, &(button->ideal));
+
+	/* Find the sprites for all of the objects in one batch, straight
+	 * into their database entries.
+	 */
+
+	i = 0;
+
+	for (drop = windat->drops; count > 0 && drop != NULL; drop = drop->next) {
+		appdb_set_defaults(entries + i);
+
+		requests[i].object = drop->object;
+		requests[i].sprite = entries[i].sprite;
+		requests[i].length = APPDB_SPRITE_LENGTH;
+		i++;
+	}
+
+	if (count > 0)
+		objutil_find_sprites(requests, count);
+
+	/* Find positions for the objects which could be identified, packing
+	 * their entries down, before anything is added to the database.
+	 */
+
+	i = 0;
+
+	for (drop = windat->drops; count > 0 && drop != NULL; drop = drop->next) {
+		entry = entries + i;
+
+		if (strlen(drop->object) >= APPDB_COMMAND_LENGTH || requests[i].result != OBJUTIL_SPRITE_FOUND ||
+				!panel_find_free_cell(occupied, depth, rows, &slab, &(windat->drop_cell), &(entry->position))) {
+			failed++;
+			i++;
+			continue;
+		}
+
+		panel_fill_cells(occupied, depth, rows, &slab, &(entry->position));
+
+		entry->panel = windat->panel_id;
+		entry->boot_action = (requests[i].bootable) ? APPDB_BOOT_ACTION_BOOT : APPDB_BOOT_ACTION_NONE;
+		string_copy(entry->name, string_find_leafname(drop->object), APPDB_NAME_LENGTH);
+		string_copy(entry->command, drop->object, APPDB_COMMAND_LENGTH);
+
+		if (added != i)
+			entries[added] = *entry;
+
+		added++;
+		i++;
+	}
+
+	/* Add the buttons to the database as a single transaction: if any
+	 * of them can't be created, none of them are.
+	 */
+
+	for (i = 0; i < added; i++) {
+		keys[i] = appdb_create_key();
+		if (keys[i] == APPDB_NULL_KEY)
+			break;
+	}
+
+	if (i < added) {
+		while (--i >= 0)
+			appdb_delete_key(keys[i]);
+
+		error_msgs_report_error("NoMemNewButton");
+		added = 0;
+	}
+
+	for (i = 0; i < added; i++)
+		appdb_set_button_info(keys[i], entries + i);
+
+	if (entries != NULL)
+		heap_free(entries);
+
+	if (requests != NULL)
+		heap_free(requests);
+
+	if (keys != NULL)
+		heap_free(keys);
+
+	if (occupied != NULL)
+		heap_free(occupied);
+
+	panel_discard_drops(windat);
+
+	/* Report any objects which couldn't be added once, rather than
+	 * stopping for each of them.
+	 */
+
+	if (failed > 0) {
+		string_printf(skipped, PANEL_DROP_COUNT_LEN, "%d", failed);
+		error_msgs_param_report_error("DropSkipped", skipped, NULL, NULL, NULL);
+	}
+
+	if (added == 0)
+		return;
+
+	windat->dirty = TRUE;
+
+	panel_add_buttons_from_db(windat);
+	panel_schedule_relayout(windat, PANEL_RELAYOUT_PANELS);
+}
+
+
+/**
+ * Discard any objects waiting to be dropped on to a panel.
+ *
+ * \param *windat		The panel to discard the objects from.
+ */
+
+static void panel_discard_drops(struct panel_block *windat)
+{
+	struct panel_drop *drop;
+
+	if (windat == NULL)
+		return;
+
+	while (windat->drops != NULL) {
+		drop = windat->drops;
+		windat->drops = drop->next;
+
+		heap_free(drop->object);
+		heap_free(drop);
+	}
+}
+
+
+/**
+ * Find the free area of the grid, big enough to hold a button, which is
+ * closest to a target cell.
+ *
+ * \param *occupied		The grid occupancy map, by row.
+ * \param depth			The number of cells across the map.
+ * \param rows			The number of rows in the map.
+ * \param *size			The size of a button, in cells.
+ * \param *target		The cell to search around.
+ * \param *cell			Pointer to a coordinate to take the free cell.
+ * \return			TRUE if a free cell was found; else FALSE.
+ */
+
+static osbool panel_find_free_cell(char *occupied, int depth, int rows, os_coord *size, os_coord *target, os_coord *cell)
+{
+	int	x, y, i, j, dx, dy, distance, nearest = INT_MAX;
+	osbool	free;
+
+	for (y = 0; y <= rows - size->y; y++) {
+		for (x = 0; x <= depth - size->x; x++) {
+			dx = x - target->x;
+			dy = y - target->y;
+			distance = (dx * dx) + (dy * dy);
+
+			if (distance >= nearest)
+				continue;
+
+			free = TRUE;
+
+			for (j = y; free && j < y + size->y; j++) {
+				for (i = x; free && i < x + size->x; i++) {
+					if (occupied[(j * depth) + i])
+						free = FALSE;
+				}
+			}
+
+			if (!free)
+				continue;
+
+			nearest = distance;
+			cell->x = x;
+			cell->y = y;
+		}
+	}
+
+	return (nearest < INT_MAX) ? TRUE : FALSE;
+}
+
+
+/**
+ * Mark the area of the grid covered by a button as occupied.
+ *
+ * \param *occupied		The grid occupancy map, by row.
+ * \param depth			The number of cells across the map.
+ * \param rows			The number of rows in the map.
+ * \param *size			The size of a button, in cells.
+ * \param *position		The position of the button.
+ */
+
+static void panel_fill_cells(char *occupied, int depth, int rows, os_coord *size, os_coord *position)
+{
+	int x, y;
+
+	for (y = position->y; y < position->y + size->y; y++) {
+		for (x = position->x; x < position->x + size->x; x++) {
+			if (x >= 0 && x < depth && y >= 0 && y < rows)
+				occupied[(y * depth) + x] = 1;
+		}
+	}
+}
+
 /**
  * Given a panel id number, return the associated panel data block.
  *
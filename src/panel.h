@@ -57,5 +57,38 @@ void panel_create_from_db(void);
 
 void panel_refresh_choices(void);
 
+
+/**
+ * Find out whether the panels have any work to do on null polls, and if
+ * so when it is next due.
+ *
+ * \param *time			Pointer to a variable to take the time at
+ *				which a null event is required.
+ * \return			TRUE if a null event is required; else FALSE.
+ */
+
+osbool panel_get_idle_time(os_t *time);
+
+
+/**
+ * Carry out any work which is due on a null poll. This should be called
+ * from the poll loop on null events.
+ */
+
+void panel_process_idle(void);
+
+
+/**
+ * Return the number of button presses whose targets had, and had not, been
+ * prefetched by the pointer resting over the button beforehand.
+ *
+ * \param *hits			Pointer to a variable to take the number
+ *				of presses whose targets were prefetched.
+ * \param *misses		Pointer to a variable to take the number
+ *				of presses whose targets were not.
+ */
+
+void panel_get_prefetch_counts(unsigned *hits, unsigned *misses);
+
 #endif
 
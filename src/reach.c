@@ -0,0 +1,403 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: reach.c
+ */
+
+/* ANSI C header files. */
+
+#include <ctype.h>
+#include <stddef.h>
+#include <string.h>
+
+/* OSLib header files. */
+
+#include "oslib/fileswitch.h"
+#include "oslib/os.h"
+#include "oslib/osfile.h"
+
+/* SF-Lib header files. */
+
+#include "sflib/heap.h"
+#include "sflib/string.h"
+
+/* Application header files. */
+
+#include "reach.h"
+
+/**
+ * The maximum length of a filing system and disc prefix, including
+ * terminator and the space needed to probe the disc's root.
+ */
+
+#define REACH_PREFIX_LEN 64
+
+/**
+ * The minimum time between background probes, in centiseconds, so that
+ * a run of unavailable discs can't hold up the desktop for long.
+ */
+
+#define REACH_PROBE_INTERVAL 25
+
+/**
+ * The time between probes of a disc which responded, in centiseconds.
+ */
+
+#define REACH_RECHECK_INTERVAL 6000
+
+/**
+ * The time before the first probe of a disc which didn't respond, in
+ * centiseconds; this doubles with each further failure.
+ */
+
+#define REACH_BACKOFF_MIN 500
+
+/**
+ * The longest time between probes of a disc which doesn't respond, in
+ * centiseconds.
+ */
+
+#define REACH_BACKOFF_MAX 24000
+
+/**
+ * A group of objects on the same filing system and disc.
+ */
+
+struct reach_group {
+	/**
+	 * The filing system and disc prefix, in lower case.
+	 */
+
+	char			prefix[REACH_PREFIX_LEN];
+
+	/**
+	 * The reachability of the disc when last probed.
+	 */
+
+	enum reach_state	state;
+
+	/**
+	 * The backoff time to be used after the next failed probe.
+	 */
+
+	int			backoff;
+
+	/**
+	 * The time at which the disc is next due to be probed.
+	 */
+
+	os_t			due;
+
+	/**
+	 * Pointer to the next group in the list.
+	 */
+
+	struct reach_group	*next;
+};
+
+/**
+ * The list of groups being tracked.
+ */
+
+static struct reach_group *reach_list = NULL;
+
+/**
+ * The time at which the last background probe was made.
+ */
+
+static os_t reach_last_probe = 0;
+
+/**
+ * The reachability generation, which changes whenever a group changes state.
+ */
+
+static unsigned reach_generation = 1;
+
+/* Static Function Prototypes. */
+
+static struct reach_group *reach_find_group(char *object);
+static void reach_probe_group(struct reach_group *group);
+
+
+/**
+ * Terminate the reachability records, freeing their memory.
+ */
+
+void reach_terminate(void)
+{
+	struct reach_group *group;
+
+	while (reach_list != NULL) {
+		group = reach_list;
+		reach_list = group->next;
+
+		heap_free(group);
+	}
+}
+
+
+/**
+ * Return the reachability of the disc holding an object, starting to
+ * track the disc if it hasn't been seen before. Objects which are not on
+ * a named disc, such as those referenced via path variables, are always
+ * reported as being reachable.
+ *
+ * \param *object	The filename of the object to test.
+ * \return		The reachability of the object's disc.
+ */
+
+enum reach_state reach_get_state(char *object)
+{
+	struct reach_group *group;
+
+	group = reach_find_group(object);
+	if (group == NULL)
+		return REACH_STATE_REACHABLE;
+
+	return group->state;
+}
+
+
+/**
+ * Return the reachability of the disc holding an object, probing the disc
+ * immediately if it hasn't been probed before. This will block if the
+ * disc is unavailable, but only once for each disc.
+ *
+ * \param *object	The filename of the object to test.
+ * \return		The reachability of the object's disc.
+ */
+
+enum reach_state reach_probe(char *object)
+{
+	struct reach_group *group;
+
+	group = reach_find_group(object);
+	if (group == NULL)
+		return REACH_STATE_REACHABLE;
+
+	if (group->state == REACH_STATE_UNKNOWN)
+		reach_probe_group(group);
+
+	return group->state;
+}
+
+
+/**
+ * Ask for the disc holding an object to be probed again as soon as
+ * possible, following a failure to access the object.
+ *
+ * \param *object	The filename of the object which failed.
+ */
+
+void reach_request_probe(char *object)
+{
+	struct reach_group *group;
+
+	group = reach_find_group(object);
+	if (group == NULL || group->state == REACH_STATE_UNREACHABLE)
+		return;
+
+	group->due = os_read_monotonic_time();
+}
+
+
+/**
+ * Return the current reachability generation, which changes whenever the
+ * reachability of a disc changes.
+ *
+ * \return		The current reachability generation.
+ */
+
+unsigned reach_get_generation(void)
+{
+	return reach_generation;
+}
+
+
+/**
+ * Find out whether any discs are due to be probed, and if so when the next
+ * probe is due.
+ *
+ * \param *time		Pointer to a variable to take the time at which a
+ *			null event is required.
+ * \return		TRUE if a null event is required; else FALSE.
+ */
+
+osbool reach_get_idle_time(os_t *time)
+{
+	struct reach_group	*group;
+	os_t			earliest;
+
+	if (time == NULL || reach_list == NULL)
+		return FALSE;
+
+	*time = reach_list->due;
+
+	for (group = reach_list->next; group != NULL; group = group->next) {
+		if ((int) (group->due - *time) < 0)
+			*time = group->due;
+	}
+
+	/* Don't wake up before the probe interval has passed. */
+
+	earliest = reach_last_probe + REACH_PROBE_INTERVAL;
+
+	if ((int) (*time - earliest) < 0)
+		*time = earliest;
+
+	return TRUE;
+}
+
+
+/**
+ * Probe the disc which is most overdue for a probe, if any. This should be
+ * called from the poll loop on null events.
+ */
+
+void reach_process_idle(void)
+{
+	struct reach_group	*group, *oldest = NULL;
+	os_t			now;
+
+	now = os_read_monotonic_time();
+
+	if ((int) (now - reach_last_probe) < REACH_PROBE_INTERVAL)
+		return;
+
+	/* Only one disc is probed on each call, since an unavailable disc
+	 * will block until its filing system gives up on it.
+	 */
+
+	for (group = reach_list; group != NULL; group = group->next) {
+		if ((int) (now - group->due) >= 0 && (oldest == NULL || (int) (group->due - oldest->due) < 0))
+			oldest = group;
+	}
+
+	if (oldest == NULL)
+		return;
+
+	reach_probe_group(oldest);
+
+	reach_last_probe = os_read_monotonic_time();
+}
+
+
+/**
+ * Find the group for the disc holding an object, creating a new group if
+ * the disc hasn't been seen before. Only objects with a filing system and
+ * disc prefix, such as "FS::Disc.$.Object", are grouped.
+ *
+ * \param *object	The filename of the object to find the group for.
+ * \return		Pointer to the group, or NULL if the object has no
+ *			disc or there was no memory.
+ */
+
+static struct reach_group *reach_find_group(char *object)
+{
+	char			prefix[REACH_PREFIX_LEN], *disc;
+	struct reach_group	*group;
+	int			i;
+
+	if (object == NULL)
+		return NULL;
+
+	disc = strstr(object, "::");
+	if (disc == NULL)
+		return NULL;
+
+	/* Take a lower case copy of everything up to the end of the disc
+	 * name, leaving space to append the root when probing. The object
+	 * may be in the flex heap, so it isn't used after this.
+	 */
+
+	for (i = 0; object[i] != '\0' && (object + i < disc + 2 || object[i] != '.'); i++) {
+		if (i >= REACH_PREFIX_LEN - 3)
+			return NULL;
+
+		prefix[i] = tolower(object[i]);
+	}
+
+	prefix[i] = '\0';
+
+	for (group = reach_list; group != NULL; group = group->next) {
+		if (strcmp(group->prefix, prefix) == 0)
+			return group;
+	}
+
+	group = heap_alloc(sizeof(struct reach_group));
+	if (group == NULL)
+		return NULL;
+
+	string_copy(group->prefix, prefix, REACH_PREFIX_LEN);
+	group->state = REACH_STATE_UNKNOWN;
+	group->backoff = REACH_BACKOFF_MIN;
+	group->due = os_read_monotonic_time();
+
+	group->next = reach_list;
+	reach_list = group;
+
+	return group;
+}
+
+
+/**
+ * Probe a disc by reading the details of its root directory, and update
+ * its group to reflect the result.
+ *
+ * \param *group	The group to probe.
+ */
+
+static void reach_probe_group(struct reach_group *group)
+{
+	char			root[REACH_PREFIX_LEN];
+	fileswitch_object_type	object_type;
+	enum reach_state	previous;
+	os_error		*error;
+
+	if (group == NULL)
+		return;
+
+	previous = group->state;
+
+	string_printf(root, REACH_PREFIX_LEN, "%s.$", group->prefix);
+
+	error = xosfile_read_stamped_no_path(root, &object_type, NULL, NULL, NULL, NULL, NULL);
+
+	if (error == NULL && object_type != fileswitch_NOT_FOUND) {
+		group->state = REACH_STATE_REACHABLE;
+		group->backoff = REACH_BACKOFF_MIN;
+		group->due = os_read_monotonic_time() + REACH_RECHECK_INTERVAL;
+	} else {
+		group->state = REACH_STATE_UNREACHABLE;
+		group->due = os_read_monotonic_time() + group->backoff;
+
+		group->backoff *= 2;
+		if (group->backoff > REACH_BACKOFF_MAX)
+			group->backoff = REACH_BACKOFF_MAX;
+	}
+
+	if (group->state != previous)
+		reach_generation++;
+}
+
@@ -0,0 +1,119 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: reach.h
+ *
+ * Filing system reachability, which groups objects by the filing system
+ * and disc that they are on, and probes each group in the background so
+ * that objects on unavailable discs can be skipped without waiting for
+ * their filing systems to time out.
+ */
+
+#ifndef LAUNCHER_REACH
+#define LAUNCHER_REACH
+
+/**
+ * The reachability of an object's filing system and disc.
+ */
+
+enum reach_state {
+	REACH_STATE_UNKNOWN = 0,	/**< The disc has not been probed yet.			*/
+	REACH_STATE_REACHABLE,		/**< The disc responded when last probed.		*/
+	REACH_STATE_UNREACHABLE		/**< The disc did not respond when last probed.		*/
+};
+
+
+/**
+ * Terminate the reachability records, freeing their memory.
+ */
+
+void reach_terminate(void);
+
+
+/**
+ * Return the reachability of the disc holding an object, starting to
+ * track the disc if it hasn't been seen before. Objects which are not on
+ * a named disc, such as those referenced via path variables, are always
+ * reported as being reachable.
+ *
+ * \param *object	The filename of the object to test.
+ * \return		The reachability of the object's disc.
+ */
+
+enum reach_state reach_get_state(char *object);
+
+
+/**
+ * Return the reachability of the disc holding an object, probing the disc
+ * immediately if it hasn't been probed before. This will block if the
+ * disc is unavailable, but only once for each disc.
+ *
+ * \param *object	The filename of the object to test.
+ * \return		The reachability of the object's disc.
+ */
+
+enum reach_state reach_probe(char *object);
+
+
+/**
+ * Ask for the disc holding an object to be probed again as soon as
+ * possible, following a failure to access the object.
+ *
+ * \param *object	The filename of the object which failed.
+ */
+
+void reach_request_probe(char *object);
+
+
+/**
+ * Return the current reachability generation, which changes whenever the
+ * reachability of a disc changes.
+ *
+ * \return		The current reachability generation.
+ */
+
+unsigned reach_get_generation(void);
+
+
+/**
+ * Find out whether any discs are due to be probed, and if so when the next
+ * probe is due.
+ *
+ * \param *time		Pointer to a variable to take the time at which a
+ *			null event is required.
+ * \return		TRUE if a null event is required; else FALSE.
+ */
+
+osbool reach_get_idle_time(os_t *time);
+
+
+/**
+ * Probe the disc which is most overdue for a probe, if any. This should be
+ * called from the poll loop on null events.
+ */
+
+void reach_process_idle(void);
+
+#endif
+
@@ -0,0 +1,254 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: layout_bench.c
+ *
+ * A host benchmark for the panel layout module, which lays out 10,000
+ * buttons on 200 panels spread around the four edges of the screen, in
+ * the same order as a full relayout in panel.c.
+ */
+
+/* ANSI C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* Application header files. */
+
+#include "layout.h"
+
+/**
+ * The number of panels to lay out.
+ */
+
+#define LAYOUT_BENCH_PANELS 200
+
+/**
+ * The number of buttons to lay out, shared equally between the panels.
+ */
+
+#define LAYOUT_BENCH_BUTTONS 10000
+
+/**
+ * The number of times to repeat the layout, unless given on the command line.
+ */
+
+#define LAYOUT_BENCH_REPEATS 20
+
+/**
+ * The stages of the layout which are timed.
+ */
+
+enum layout_bench_stage {
+	LAYOUT_BENCH_ARRANGE = 0,
+	LAYOUT_BENCH_REFLOW,
+	LAYOUT_BENCH_EXTENT,
+	LAYOUT_BENCH_ICONS,
+	LAYOUT_BENCH_STAGES
+};
+
+/**
+ * The names of the timed stages.
+ */
+
+static const char *layout_bench_stage_names[] = {
+	"arrange panels",
+	"reflow buttons",
+	"panel extents",
+	"icon extents"
+};
+
+/**
+ * The state of the pseudo-random number generator, so that every run lays
+ * out the same buttons.
+ */
+
+static unsigned long layout_bench_seed = 1;
+
+/* Static Function Prototypes. */
+
+static void layout_bench_build(struct layout_panel *panels, struct layout_button *buttons);
+static int layout_bench_compare_buttons(const void *p, const void *q);
+static int layout_bench_random(int range);
+
+
+/**
+ * Lay out the panels repeatedly, reporting the time taken by each stage.
+ *
+ * \param argc		The number of command line arguments.
+ * \param *argv[]	The command line arguments.
+ * \return		The exit status.
+ */
+
+int main(int argc, char *argv[])
+{
+	static struct layout_panel	panels[LAYOUT_BENCH_PANELS];
+	static struct layout_button	buttons[LAYOUT_BENCH_BUTTONS];
+	struct layout_panel		*order[LAYOUT_BENCH_PANELS];
+	struct layout_screen		screen = {3840, 2160, 136, 2, 2, 24, 24};
+	struct layout_coord		slab;
+	struct layout_box		extent;
+	clock_t				start, times[LAYOUT_BENCH_STAGES] = {0};
+	unsigned long			checksum = 0;
+	int				repeats = LAYOUT_BENCH_REPEATS, per_panel, run, i, j, stage;
+
+	if (argc > 1)
+		repeats = atoi(argv[1]);
+
+	if (repeats < 1)
+		repeats = 1;
+
+	per_panel = LAYOUT_BENCH_BUTTONS / LAYOUT_BENCH_PANELS;
+
+	layout_bench_build(panels, buttons);
+
+	for (run = 0; run < repeats; run++) {
+		for (i = 0; i < LAYOUT_BENCH_PANELS; i++)
+			order[i] = panels + i;
+
+		start = clock();
+		layout_arrange_panels(order, LAYOUT_BENCH_PANELS, &screen);
+		times[LAYOUT_BENCH_ARRANGE] += clock() - start;
+
+		start = clock();
+
+		for (i = 0; i < LAYOUT_BENCH_PANELS; i++) {
+			slab.x = (i % 5 == 0) ? 2 : 1;
+			slab.y = (i % 7 == 0) ? 2 : 1;
+
+			layout_set_grid(panels + i, 44, 4, 2 + (i % 3), &slab);
+			layout_reflow_buttons(panels + i, buttons + (i * per_panel), per_panel);
+		}
+
+		times[LAYOUT_BENCH_REFLOW] += clock() - start;
+
+		start = clock();
+
+		for (i = 0; i < LAYOUT_BENCH_PANELS; i++)
+			layout_set_extent(panels + i, &screen);
+
+		times[LAYOUT_BENCH_EXTENT] += clock() - start;
+
+		start = clock();
+
+		for (i = 0; i < LAYOUT_BENCH_PANELS; i++) {
+			for (j = 0; j < per_panel; j++) {
+				layout_get_button_extent(panels + i, &(buttons[(i * per_panel) + j].position), &extent);
+				checksum += (unsigned long) (extent.x0 + extent.y0 + extent.x1 + extent.y1);
+			}
+		}
+
+		times[LAYOUT_BENCH_ICONS] += clock() - start;
+	}
+
+	printf("%d panels, %d buttons, %d runs (checksum %lu)\n", LAYOUT_BENCH_PANELS, LAYOUT_BENCH_BUTTONS,
+			repeats, checksum / (unsigned long) repeats);
+
+	for (stage = 0; stage < LAYOUT_BENCH_STAGES; stage++) {
+		printf("  %-16s %10.3f ms per layout\n", layout_bench_stage_names[stage],
+				1000.0 * (double) times[stage] / CLOCKS_PER_SEC / repeats);
+	}
+
+	return EXIT_SUCCESS;
+}
+
+
+/**
+ * Set up the panels and buttons to be laid out. The panels are spread
+ * around the four edges, with a range of weights and sort orders, and
+ * each has a share of the buttons scattered along its length with some
+ * clashing and some falling beyond the end of the panel.
+ *
+ * \param *panels	The array of panels to set up.
+ * \param *buttons	The array of buttons to set up.
+ */
+
+static void layout_bench_build(struct layout_panel *panels, struct layout_button *buttons)
+{
+	static const enum layout_position locations[] = {
+		LAYOUT_POSITION_LEFT,
+		LAYOUT_POSITION_RIGHT,
+		LAYOUT_POSITION_TOP,
+		LAYOUT_POSITION_BOTTOM
+	};
+
+	struct layout_button	*panel_buttons;
+	int			per_panel, i, j;
+
+	per_panel = LAYOUT_BENCH_BUTTONS / LAYOUT_BENCH_PANELS;
+
+	for (i = 0; i < LAYOUT_BENCH_PANELS; i++) {
+		layout_initialise_panel(panels + i);
+
+		panels[i].location = locations[i % 4];
+		panels[i].sort = layout_bench_random(LAYOUT_BENCH_PANELS);
+		panels[i].longitude_weight = 1 + layout_bench_random(3);
+
+		panel_buttons = buttons + (i * per_panel);
+
+		for (j = 0; j < per_panel; j++) {
+			panel_buttons[j].ideal.x = layout_bench_random(3);
+			panel_buttons[j].ideal.y = layout_bench_random(per_panel);
+		}
+
+		qsort(panel_buttons, per_panel, sizeof(struct layout_button), layout_bench_compare_buttons);
+	}
+}
+
+
+/**
+ * Compare two buttons, so that they sort into the order in which the icon
+ * database keeps them: by row, and then by column.
+ *
+ * \param *p		The first button to compare.
+ * \param *q		The second button to compare.
+ * \return		-1, 0 or +1 depending on sort order.
+ */
+
+static int layout_bench_compare_buttons(const void *p, const void *q)
+{
+	const struct layout_button *a = p, *b = q;
+
+	if (a->ideal.y != b->ideal.y)
+		return (a->ideal.y > b->ideal.y) - (a->ideal.y < b->ideal.y);
+
+	return (a->ideal.x > b->ideal.x) - (a->ideal.x < b->ideal.x);
+}
+
+
+/**
+ * Return a repeatable pseudo-random number.
+ *
+ * \param range		The number of possible values to return.
+ * \return		A value from 0 to range - 1.
+ */
+
+static int layout_bench_random(int range)
+{
+	layout_bench_seed = (layout_bench_seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+
+	return (int) ((layout_bench_seed >> 16) % (unsigned long) range);
+}
+
@@ -0,0 +1,338 @@
+/* Copyright 2020, Stephen Fryatt (info@stevefryatt.org.uk)
+ *
+ * This file is part of Launcher:
+ *
+ *   http://www.stevefryatt.org.uk/risc-os
+ *
+ * Licensed under the EUPL, Version 1.2 only (the "Licence");
+ * You may not use this work except in compliance with the
+ * Licence.
+ *
+ * You may obtain a copy of the Licence at:
+ *
+ *   http://joinup.ec.europa.eu/software/page/eupl
+ *
+ * Unless required by applicable law or agreed to in
+ * writing, software distributed under the Licence is
+ * distributed on an "AS IS" basis, WITHOUT WARRANTIES
+ * OR CONDITIONS OF ANY KIND, either express or implied.
+ *
+ * See the Licence for the specific language governing
+ * permissions and limitations under the Licence.
+ */
+
+/**
+ * \file: layout_test.c
+ *
+ * Golden output tests for the panel layout module, which can be built and
+ * run on the host. Each scenario is laid out in the same way as panel.c
+ * does it, and the results are written to stdout so that they can be
+ * compared against layout.golden.
+ */
+
+/* ANSI C header files. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Application header files. */
+
+#include "layout.h"
+
+/**
+ * The maximum number of panels or buttons in a test scenario.
+ */
+
+#define LAYOUT_TEST_MAX 32
+
+/**
+ * A button in a test scenario.
+ */
+
+struct layout_test_button {
+	int x;
+	int y;
+};
+
+/**
+ * A panel in a test scenario.
+ */
+
+struct layout_test_panel {
+	enum layout_position		location;
+	int				sort;
+	int				weight;
+	int				depth;
+	struct layout_coord		slab;
+	bool				scrolling;
+	int				scroll;
+	size_t				count;
+	struct layout_test_button	buttons[LAYOUT_TEST_MAX];
+};
+
+/**
+ * A test scenario.
+ */
+
+struct layout_test_scenario {
+	const char			*name;
+	struct layout_screen		screen;
+	int				grid_square;
+	int				grid_spacing;
+	size_t				count;
+	struct layout_test_panel	panels[LAYOUT_TEST_MAX];
+};
+
+/**
+ * A screen in a typical widescreen mode, with two OS units per pixel.
+ */
+
+#define LAYOUT_TEST_WIDE {3840, 2160, 136, 2, 2, 24, 24}
+
+/**
+ * A screen in a small square-pixel mode.
+ */
+
+#define LAYOUT_TEST_SMALL {1280, 1024, 96, 2, 2, 16, 16}
+
+/**
+ * The test scenarios.
+ */
+
+static struct layout_test_scenario layout_test_scenarios[] = {
+	{
+		"one panel on each edge", LAYOUT_TEST_WIDE, 64, 4, 4, {
+			{LAYOUT_POSITION_LEFT, 0, 1, 2, {1, 1}, false, 0, 5,
+				{{0, 0}, {1, 0}, {0, 1}, {1, 1}, {0, 3}}},
+			{LAYOUT_POSITION_RIGHT, 0, 1, 1, {1, 1}, false, 0, 3,
+				{{0, 0}, {0, 1}, {0, 2}}},
+			{LAYOUT_POSITION_TOP, 0, 1, 1, {1, 1}, false, 0, 4,
+				{{0, 0}, {0, 2}, {0, 4}, {0, 6}}},
+			{LAYOUT_POSITION_BOTTOM, 0, 1, 3, {1, 1}, false, 0, 3,
+				{{0, 0}, {2, 0}, {1, 5}}}
+		}
+	},
+	{
+		"weighted panels sharing an edge", LAYOUT_TEST_WIDE, 48, 8, 4, {
+			{LAYOUT_POSITION_LEFT, 2, 1, 1, {1, 1}, false, 0, 2,
+				{{0, 0}, {0, 1}}},
+			{LAYOUT_POSITION_LEFT, 0, 2, 1, {1, 1}, false, 0, 2,
+				{{0, 0}, {0, 4}}},
+			{LAYOUT_POSITION_LEFT, 1, 1, 2, {1, 1}, false, 0, 1,
+				{{1, 2}}},
+			{LAYOUT_POSITION_BOTTOM, 0, 1, 1, {1, 1}, false, 0, 1,
+				{{0, 0}}}
+		}
+	},
+	{
+		"overflowing buttons", LAYOUT_TEST_SMALL, 64, 4, 1, {
+			{LAYOUT_POSITION_RIGHT, 0, 1, 1, {1, 1}, false, 0, 8,
+				{{0, 0}, {0, 2}, {0, 4}, {0, 9}, {0, 12}, {0, 20}, {0, 21}, {0, 40}}}
+		}
+	},
+	{
+		"large slabs with clashes", LAYOUT_TEST_WIDE, 32, 4, 2, {
+			{LAYOUT_POSITION_TOP, 0, 1, 4, {2, 2}, false, 0, 6,
+				{{0, 0}, {1, 0}, {3, 0}, {0, 1}, {2, 3}, {2, 4}}},
+			{LAYOUT_POSITION_LEFT, 0, 1, 2, {2, 1}, false, 0, 4,
+				{{0, 0}, {1, 0}, {0, 1}, {1, 1}}}
+		}
+	},
+	{
+		"scrolling panels", LAYOUT_TEST_SMALL, 64, 4, 2, {
+			{LAYOUT_POSITION_LEFT, 0, 1, 1, {1, 1}, true, 500, 6,
+				{{0, 0}, {0, 3}, {0, 10}, {0, 18}, {0, 24}, {0, 30}}},
+			{LAYOUT_POSITION_BOTTOM, 0, 1, 1, {1, 1}, true, 100000, 5,
+				{{0, 0}, {0, 6}, {0, 22}, {0, 23}, {0, 40}}}
+		}
+	}
+};
+
+/* Static Function Prototypes. */
+
+static void layout_test_run(struct layout_test_scenario *scenario);
+static void layout_test_dump_panel(size_t index, struct layout_panel *panel, struct layout_screen *screen,
+		struct layout_button *buttons, size_t count);
+static int layout_test_compare_buttons(const void *p, const void *q);
+static const char *layout_test_location_name(enum layout_position location);
+
+
+/**
+ * Run all of the test scenarios, writing their results to stdout.
+ *
+ * \return		The exit status.
+ */
+
+int main(void)
+{
+	size_t i;
+
+	for (i = 0; i < sizeof(layout_test_scenarios) / sizeof(struct layout_test_scenario); i++)
+		layout_test_run(layout_test_scenarios + i);
+
+	return EXIT_SUCCESS;
+}
+
+
+/**
+ * Lay out a test scenario, in the same order as panel.c, and write the
+ * results to stdout.
+ *
+ * \param *scenario	The scenario to lay out.
+ */
+
+static void layout_test_run(struct layout_test_scenario *scenario)
+{
+	struct layout_panel	panels[LAYOUT_TEST_MAX], *order[LAYOUT_TEST_MAX];
+	struct layout_button	buttons[LAYOUT_TEST_MAX];
+	struct layout_test_panel *source;
+	size_t			i, j;
+
+	printf("scenario: %s\n", scenario->name);
+
+	for (i = 0; i < scenario->count; i++) {
+		source = scenario->panels + i;
+
+		layout_initialise_panel(panels + i);
+		panels[i].location = source->location;
+		panels[i].sort = source->sort;
+		panels[i].longitude_weight = source->weight;
+
+		order[i] = panels + i;
+	}
+
+	layout_arrange_panels(order, scenario->count, &(scenario->screen));
+
+	for (i = 0; i < scenario->count; i++) {
+		source = scenario->panels + i;
+
+		layout_set_grid(panels + i, scenario->grid_square, scenario->grid_spacing, source->depth, &(source->slab));
+		panels[i].scrolling = source->scrolling;
+
+		for (j = 0; j < source->count; j++) {
+			buttons[j].ideal.x = source->buttons[j].x;
+			buttons[j].ideal.y = source->buttons[j].y;
+		}
+
+		qsort(buttons, source->count, sizeof(struct layout_button), layout_test_compare_buttons);
+
+		layout_reflow_buttons(panels + i, buttons, source->count);
+		layout_set_extent(panels + i, &(scenario->screen));
+		layout_set_scroll(panels + i, source->scroll);
+
+		layout_test_dump_panel(i, panels + i, &(scenario->screen), buttons, source->count);
+	}
+
+	printf("\n");
+}
+
+
+/**
+ * Write the calculated layout of a panel to stdout.
+ *
+ * \param index		The index of the panel in its scenario.
+ * \param *panel	The panel to write out.
+ * \param *screen	The screen on which the panel is laid out.
+ * \param *buttons	The panel's reflowed buttons.
+ * \param count		The number of buttons.
+ */
+
+static void layout_test_dump_panel(size_t index, struct layout_panel *panel, struct layout_screen *screen,
+		struct layout_button *buttons, size_t count)
+{
+	struct layout_box	box, area;
+	struct layout_coord	coord, cell;
+	int			first, last;
+	size_t			i;
+
+	printf("  panel %zu: %s longitude %d to %d, grid %dx%d, origin (%d,%d)\n", index,
+			layout_test_location_name(panel->location), panel->min_longitude, panel->max_longitude,
+			panel->grid_dimensions.x, panel->grid_dimensions.y, panel->origin.x, panel->origin.y);
+
+	printf("    extent (%d,%d,%d,%d) sidebar (%d,%d,%d,%d) scroll %d\n",
+			panel->extent.x0, panel->extent.y0, panel->extent.x1, panel->extent.y1,
+			panel->sidebar.x0, panel->sidebar.y0, panel->sidebar.x1, panel->sidebar.y1, panel->scroll);
+
+	layout_get_open_box(panel, screen, true, &box, &coord);
+	printf("    open (%d,%d,%d,%d) at (%d,%d)\n", box.x0, box.y0, box.x1, box.y1, coord.x, coord.y);
+
+	layout_get_open_box(panel, screen, false, &box, &coord);
+	printf("    closed (%d,%d,%d,%d) at (%d,%d)\n", box.x0, box.y0, box.x1, box.y1, coord.x, coord.y);
+
+	if (layout_get_visible_rows(panel, 2, &first, &last))
+		printf("    visible rows %d to %d\n", first, last);
+	else
+		printf("    no visible rows\n");
+
+	for (i = 0; i < count; i++) {
+		layout_get_button_extent(panel, &(buttons[i].position), &box);
+
+		/* Map the centre of the button back to its grid cell, and find
+		 * the rows which a redraw of just the button would cover.
+		 */
+
+		coord.x = (box.x0 + box.x1) / 2;
+		coord.y = (box.y0 + box.y1) / 2;
+		layout_get_grid_cell(panel, &coord, &cell);
+
+		area = box;
+		if (!layout_get_row_range(panel, &area, &first, &last)) {
+			first = -1;
+			last = -1;
+		}
+
+		printf("    button (%d,%d) -> (%d,%d) icon (%d,%d,%d,%d) cell (%d,%d) rows %d to %d\n",
+				buttons[i].ideal.x, buttons[i].ideal.y, buttons[i].position.x, buttons[i].position.y,
+				box.x0, box.y0, box.x1, box.y1, cell.x, cell.y, first, last);
+	}
+}
+
+
+/**
+ * Compare two buttons, so that they sort into the order in which the icon
+ * database keeps them: by row, and then by column.
+ *
+ * \param *p		The first button to compare.
+ * \param *q		The second button to compare.
+ * \return		-1, 0 or +1 depending on sort order.
+ */
+
+static int layout_test_compare_buttons(const void *p, const void *q)
+{
+	const struct layout_button *a = p, *b = q;
+
+	if (a->ideal.y != b->ideal.y)
+		return (a->ideal.y > b->ideal.y) - (a->ideal.y < b->ideal.y);
+
+	return (a->ideal.x > b->ideal.x) - (a->ideal.x < b->ideal.x);
+}
+
+
+/**
+ * Return a name for a panel location.
+ *
+ * \param location	The location to name.
+ * \return		Pointer to the name of the location.
+ */
+
+static const char *layout_test_location_name(enum layout_position location)
+{
+	switch (location) {
+	case LAYOUT_POSITION_LEFT:
+		return "left";
+	case LAYOUT_POSITION_RIGHT:
+		return "right";
+	case LAYOUT_POSITION_TOP:
+		return "top";
+	case LAYOUT_POSITION_BOTTOM:
+		return "bottom";
+	case LAYOUT_POSITION_VERTICAL:
+	case LAYOUT_POSITION_HORIZONTAL:
+	case LAYOUT_POSITION_NONE:
+		break;
+	}
+
+	return "none";
+}
+